@@ -99,6 +99,42 @@ bool RasConfig::Load(const std::string& path, std::string& error) {
                 m_server.access_plus = (ToLower(value) == "true" || value == "1");
             } else if (key == "bind_ip") {
                 m_server.bind_ip = value;
+            } else if (key == "rpc_batch") {
+                m_server.rpc_batch = std::stoi(value);
+            } else if (key == "workers") {
+                m_server.workers = std::stoi(value);
+            } else if (key == "max_transfers") {
+                m_server.max_transfers = std::stoi(value);
+            } else if (key == "transfer_timeout") {
+                m_server.transfer_timeout = std::stoi(value);
+            } else if (key == "read_window") {
+                m_server.read_window = std::stoi(value);
+            } else if (key == "read_chunk") {
+                m_server.read_chunk = std::stoi(value);
+            } else if (key == "write_chunk") {
+                m_server.write_chunk = std::stoi(value);
+            } else if (key == "write_window") {
+                m_server.write_window = std::stoi(value);
+            } else if (key == "write_reorder_bytes") {
+                m_server.write_reorder_bytes = std::stoi(value);
+            } else if (key == "readahead_bytes") {
+                m_server.readahead_bytes = std::stoi(value);
+            } else if (key == "reply_cache_entries") {
+                m_server.reply_cache_entries = std::stoi(value);
+            } else if (key == "reply_cache_bytes") {
+                m_server.reply_cache_bytes = std::stoi(value);
+            } else if (key == "reply_cache_ttl") {
+                m_server.reply_cache_ttl = std::stoi(value);
+            } else if (key == "dir_cache_dirs") {
+                m_server.dir_cache_dirs = std::stoi(value);
+            } else if (key == "dir_cache_ttl") {
+                m_server.dir_cache_ttl = std::stoi(value);
+            } else if (key == "path_cache_entries") {
+                m_server.path_cache_entries = std::stoi(value);
+            } else if (key == "attr_cache_entries") {
+                m_server.attr_cache_entries = std::stoi(value);
+            } else if (key == "attr_cache_ttl") {
+                m_server.attr_cache_ttl = std::stoi(value);
             }
         } else if (currentShare) {
             if (key == "path") {
@@ -109,6 +145,12 @@ bool RasConfig::Load(const std::string& path, std::string& error) {
                 currentShare->password = value;
             } else if (key == "default_filetype") {
                 currentShare->default_type = value;
+            } else if (key == "write_buffer") {
+                currentShare->write_buffer = std::stoi(value);
+            } else if (key == "stat_threads") {
+                currentShare->stat_threads = std::stoi(value);
+            } else if (key == "metadata") {
+                currentShare->metadata = value;
             }
         } else if (currentPrinter) {
             if (key == "path") {
@@ -156,6 +198,24 @@ bool RasConfig::Save(const std::string& path, std::string& error) {
     if (!m_server.bind_ip.empty()) {
         file << "bind_ip = " << m_server.bind_ip << "\n";
     }
+    file << "workers = " << m_server.workers << "\n";
+    file << "rpc_batch = " << m_server.rpc_batch << "\n";
+    file << "max_transfers = " << m_server.max_transfers << "\n";
+    file << "transfer_timeout = " << m_server.transfer_timeout << "\n";
+    file << "read_window = " << m_server.read_window << "\n";
+    file << "read_chunk = " << m_server.read_chunk << "\n";
+    file << "write_chunk = " << m_server.write_chunk << "\n";
+    file << "write_window = " << m_server.write_window << "\n";
+    file << "write_reorder_bytes = " << m_server.write_reorder_bytes << "\n";
+    file << "readahead_bytes = " << m_server.readahead_bytes << "\n";
+    file << "reply_cache_entries = " << m_server.reply_cache_entries << "\n";
+    file << "reply_cache_bytes = " << m_server.reply_cache_bytes << "\n";
+    file << "reply_cache_ttl = " << m_server.reply_cache_ttl << "\n";
+    file << "dir_cache_dirs = " << m_server.dir_cache_dirs << "\n";
+    file << "dir_cache_ttl = " << m_server.dir_cache_ttl << "\n";
+    file << "path_cache_entries = " << m_server.path_cache_entries << "\n";
+    file << "attr_cache_entries = " << m_server.attr_cache_entries << "\n";
+    file << "attr_cache_ttl = " << m_server.attr_cache_ttl << "\n";
     file << "\n";
     
     // Shares
@@ -171,6 +231,15 @@ bool RasConfig::Save(const std::string& path, std::string& error) {
         if (!share.default_type.empty()) {
             file << "default_filetype = " << share.default_type << "\n";
         }
+        if (share.write_buffer != 65536) {
+            file << "write_buffer = " << share.write_buffer << "\n";
+        }
+        if (share.stat_threads != 1) {
+            file << "stat_threads = " << share.stat_threads << "\n";
+        }
+        if (share.metadata != "suffix") {
+            file << "metadata = " << share.metadata << "\n";
+        }
         file << "\n";
     }
     
@@ -20,6 +20,9 @@ struct ShareConfig {
     uint32_t attributes = 0;
     std::string password;
     std::string default_type;
+    int write_buffer = 65536;
+    int stat_threads = 1;
+    std::string metadata = "suffix";
 };
 
 struct PrinterConfig {
@@ -41,6 +44,24 @@ struct ServerConfig {
     int broadcast_interval = 60;
     bool access_plus = false;
     std::string bind_ip;
+    int rpc_batch = 16;
+    int workers = 1;
+    int max_transfers = 1024;
+    int transfer_timeout = 30;
+    int read_window = 4;
+    int read_chunk = 0;
+    int write_chunk = 4096;
+    int write_window = 4;
+    int write_reorder_bytes = 65536;
+    int readahead_bytes = 131072;
+    int reply_cache_entries = 256;
+    int reply_cache_bytes = 1048576;
+    int reply_cache_ttl = 10;
+    int dir_cache_dirs = 256;
+    int dir_cache_ttl = 5;
+    int path_cache_entries = 4096;
+    int attr_cache_entries = 4096;
+    int attr_cache_ttl = 1;
 };
 
 class RasConfig {
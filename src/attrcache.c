@@ -0,0 +1,109 @@
+// RISC OS Access/ShareFS Server - Attribute Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "attrcache.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Direct-mapped like the path cache: one slot per path, newest wins
+typedef struct {
+    uint32_t hash;
+    char *path;             // NULL while the slot is empty
+    size_t path_cap;
+    struct stat st;
+    uint64_t stored_ms;
+} attr_entry;
+
+static ras_mutex g_lock;
+static attr_entry *g_slots = NULL;
+static size_t g_slot_count = 0;  // Power of two, 0 when disabled
+static uint64_t g_ttl_ms = 0;
+
+static uint32_t hash_path(const char *path) {
+    uint32_t h = 2166136261u;
+    for (const char *p = path; *p; ++p) {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int ras_attrcache_init(const ras_config *cfg) {
+    ras_mutex_init(&g_lock);
+    size_t want = cfg && cfg->server.attr_cache_entries > 0 ? (size_t)cfg->server.attr_cache_entries : 0;
+    g_ttl_ms = cfg && cfg->server.attr_cache_ttl > 0 ? (uint64_t)cfg->server.attr_cache_ttl * 1000u : 0;
+    if (want == 0 || g_ttl_ms == 0) return 0;
+    size_t count = 16;
+    while (count < want) count *= 2;
+    g_slots = (attr_entry *)calloc(count, sizeof(attr_entry));
+    if (!g_slots) return -1;
+    g_slot_count = count;
+    return 0;
+}
+
+void ras_attrcache_shutdown(void) {
+    for (size_t i = 0; i < g_slot_count; ++i) free(g_slots[i].path);
+    free(g_slots);
+    g_slots = NULL;
+    g_slot_count = 0;
+    ras_mutex_destroy(&g_lock);
+}
+
+int ras_attrcache_get(const char *host_path, struct stat *st) {
+    if (g_slot_count == 0 || !host_path) return -1;
+    uint32_t hash = hash_path(host_path);
+    uint64_t now = ras_monotonic_ms();
+    int rc = -1;
+
+    ras_mutex_lock(&g_lock);
+    attr_entry *e = &g_slots[hash & (g_slot_count - 1)];
+    if (e->path && e->hash == hash && strcmp(e->path, host_path) == 0) {
+        if (now - e->stored_ms <= g_ttl_ms) {
+            *st = e->st;
+            rc = 0;
+        } else {
+            e->path[0] = '\0';
+            e->hash = 0;
+        }
+    }
+    ras_mutex_unlock(&g_lock);
+    return rc;
+}
+
+void ras_attrcache_put(const char *host_path, const struct stat *st) {
+    if (g_slot_count == 0 || !host_path || !st) return;
+    uint32_t hash = hash_path(host_path);
+    size_t len = strlen(host_path) + 1;
+
+    ras_mutex_lock(&g_lock);
+    attr_entry *e = &g_slots[hash & (g_slot_count - 1)];
+    if (e->path_cap < len) {
+        char *p = (char *)realloc(e->path, len);
+        if (!p) {
+            ras_mutex_unlock(&g_lock);
+            return;
+        }
+        e->path = p;
+        e->path_cap = len;
+    }
+    memcpy(e->path, host_path, len);
+    e->hash = hash;
+    e->st = *st;
+    e->stored_ms = ras_monotonic_ms();
+    ras_mutex_unlock(&g_lock);
+}
+
+void ras_attrcache_invalidate(const char *host_path) {
+    if (g_slot_count == 0 || !host_path) return;
+    uint32_t hash = hash_path(host_path);
+    ras_mutex_lock(&g_lock);
+    attr_entry *e = &g_slots[hash & (g_slot_count - 1)];
+    if (e->path && e->hash == hash && strcmp(e->path, host_path) == 0) {
+        e->path[0] = '\0';
+        e->hash = 0;
+    }
+    ras_mutex_unlock(&g_lock);
+}
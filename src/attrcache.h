@@ -0,0 +1,26 @@
+// RISC OS Access/ShareFS Server - Attribute Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_ATTRCACHE_H
+#define RAS_ATTRCACHE_H
+
+#include "config.h"
+
+#include <sys/stat.h>
+
+// Recent stat() results by host path, so bursts of RFIND and open
+// requests for the same files are answered from memory. Entries last
+// attr_cache_ttl seconds; the server forgets a path whenever it changes
+// it. Shared by all workers.
+int ras_attrcache_init(const ras_config *cfg);
+void ras_attrcache_shutdown(void);
+
+// Details of host_path if recorded recently, returns 0 on a hit
+int ras_attrcache_get(const char *host_path, struct stat *st);
+void ras_attrcache_put(const char *host_path, const struct stat *st);
+
+// Forget host_path after changing it
+void ras_attrcache_invalidate(const char *host_path);
+
+#endif
@@ -3,6 +3,7 @@
 // License: GPL-3.0-only
 
 #include "config.h"
+#include "riscos.h"
 
 #include <ctype.h>
 #include <stdio.h>
@@ -101,6 +102,13 @@ static int str_ieq(const char *a, const char *b) {
     return *a == '\0' && *b == '\0';
 }
 
+static int mem_ieq(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return 0;
+    }
+    return 1;
+}
+
 static uint32_t parse_share_attrs(const char *val) {
     uint32_t attrs = 0;
     if (!val) return attrs;
@@ -119,6 +127,40 @@ static uint32_t parse_share_attrs(const char *val) {
     return attrs;
 }
 
+// FNV-1a of the case-folded name, so lookups ignore case as RISC OS does
+static uint32_t share_hash(const char *name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint32_t)tolower((unsigned char)name[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Index share names once loaded; the first of any duplicates wins, as
+// it did when shares were searched in order
+static int build_share_index(ras_config *cfg) {
+    size_t size = 16;
+    while (size < cfg->share_count * 2) size *= 2;
+    cfg->share_index = (uint32_t *)calloc(size, sizeof(uint32_t));
+    if (!cfg->share_index) return -1;
+    cfg->share_index_size = size;
+
+    for (size_t i = 0; i < cfg->share_count; ++i) {
+        ras_share_config *s = &cfg->shares[i];
+        if (!s->name) continue;
+        s->name_len = strlen(s->name);
+        s->path_len = s->path ? strlen(s->path) : 0;
+        s->name_hash = share_hash(s->name, s->name_len);
+        if (ras_config_find_share(cfg, s->name, s->name_len)) continue;
+
+        size_t slot = s->name_hash & (size - 1);
+        while (cfg->share_index[slot] != 0) slot = (slot + 1) & (size - 1);
+        cfg->share_index[slot] = (uint32_t)(i + 1);
+    }
+    return 0;
+}
+
 static int parse_section(const char *label, char *kind, size_t kind_sz, char *name, size_t name_sz) {
     const char *colon = strchr(label, ':');
     if (colon) {
@@ -146,6 +188,24 @@ int ras_config_load(const char *path, ras_config *out) {
     out->server.log_level = ras_strdup("info");
     out->server.broadcast_interval = 30;
     out->server.access_plus = 1;
+    out->server.rpc_batch = 16;
+    out->server.workers = 1;
+    out->server.max_transfers = 1024;
+    out->server.transfer_timeout = 30;
+    out->server.read_window = 4;
+    out->server.read_chunk = 0;
+    out->server.write_chunk = 4096;
+    out->server.write_window = 4;
+    out->server.write_reorder_bytes = 65536;
+    out->server.readahead_bytes = 131072;
+    out->server.reply_cache_entries = 256;
+    out->server.reply_cache_bytes = 1048576;
+    out->server.reply_cache_ttl = 10;
+    out->server.dir_cache_dirs = 256;
+    out->server.dir_cache_ttl = 5;
+    out->server.path_cache_entries = 4096;
+    out->server.attr_cache_entries = 4096;
+    out->server.attr_cache_ttl = 1;
 
     FILE *fp = fopen(path, "r");
     if (!fp) {
@@ -173,6 +233,8 @@ int ras_config_load(const char *path, ras_config *out) {
             if (strcmp(section_kind, "share") == 0) {
                 if (grow_shares(out) != 0) { status = -1; break; }
                 out->shares[out->share_count - 1].name = ras_strdup(section_name);
+                out->shares[out->share_count - 1].write_buffer = 65536;
+                out->shares[out->share_count - 1].stat_threads = 1;
             } else if (strcmp(section_kind, "printer") == 0) {
                 if (grow_printers(out) != 0) { status = -1; break; }
                 out->printers[out->printer_count - 1].name = ras_strdup(section_name);
@@ -198,6 +260,65 @@ int ras_config_load(const char *path, ras_config *out) {
                 parse_int(val, &out->server.broadcast_interval);
             } else if (strcmp(key, "access_plus") == 0) {
                 out->server.access_plus = (str_ieq(val, "true") || strcmp(val, "1") == 0) ? 1 : 0;
+            } else if (strcmp(key, "rpc_batch") == 0) {
+                parse_int(val, &out->server.rpc_batch);
+            } else if (strcmp(key, "workers") == 0) {
+                parse_int(val, &out->server.workers);
+                if (out->server.workers < 1) out->server.workers = 1;
+                if (out->server.workers > RAS_MAX_WORKERS) out->server.workers = RAS_MAX_WORKERS;
+            } else if (strcmp(key, "max_transfers") == 0) {
+                parse_int(val, &out->server.max_transfers);
+                if (out->server.max_transfers < 1) out->server.max_transfers = 1;
+            } else if (strcmp(key, "transfer_timeout") == 0) {
+                parse_int(val, &out->server.transfer_timeout);
+                if (out->server.transfer_timeout < 0) out->server.transfer_timeout = 0;
+            } else if (strcmp(key, "read_window") == 0) {
+                parse_int(val, &out->server.read_window);
+                if (out->server.read_window < 1) out->server.read_window = 1;
+                if (out->server.read_window > RAS_MAX_READ_WINDOW) out->server.read_window = RAS_MAX_READ_WINDOW;
+            } else if (strcmp(key, "read_chunk") == 0) {
+                parse_int(val, &out->server.read_chunk);
+                if (out->server.read_chunk < 0) out->server.read_chunk = 0;
+                if (out->server.read_chunk > 0 && out->server.read_chunk < 256) out->server.read_chunk = 256;
+                if (out->server.read_chunk > RAS_MAX_READ_CHUNK) out->server.read_chunk = RAS_MAX_READ_CHUNK;
+            } else if (strcmp(key, "write_chunk") == 0) {
+                parse_int(val, &out->server.write_chunk);
+                if (out->server.write_chunk < 256) out->server.write_chunk = 256;
+                if (out->server.write_chunk > RAS_MAX_WRITE_CHUNK) out->server.write_chunk = RAS_MAX_WRITE_CHUNK;
+            } else if (strcmp(key, "write_window") == 0) {
+                parse_int(val, &out->server.write_window);
+                if (out->server.write_window < 1) out->server.write_window = 1;
+                if (out->server.write_window > RAS_MAX_WRITE_WINDOW) out->server.write_window = RAS_MAX_WRITE_WINDOW;
+            } else if (strcmp(key, "write_reorder_bytes") == 0) {
+                parse_int(val, &out->server.write_reorder_bytes);
+                if (out->server.write_reorder_bytes < 0) out->server.write_reorder_bytes = 0;
+            } else if (strcmp(key, "readahead_bytes") == 0) {
+                parse_int(val, &out->server.readahead_bytes);
+                if (out->server.readahead_bytes < 0) out->server.readahead_bytes = 0;
+            } else if (strcmp(key, "reply_cache_entries") == 0) {
+                parse_int(val, &out->server.reply_cache_entries);
+                if (out->server.reply_cache_entries < 0) out->server.reply_cache_entries = 0;
+            } else if (strcmp(key, "reply_cache_bytes") == 0) {
+                parse_int(val, &out->server.reply_cache_bytes);
+                if (out->server.reply_cache_bytes < 0) out->server.reply_cache_bytes = 0;
+            } else if (strcmp(key, "reply_cache_ttl") == 0) {
+                parse_int(val, &out->server.reply_cache_ttl);
+                if (out->server.reply_cache_ttl < 0) out->server.reply_cache_ttl = 0;
+            } else if (strcmp(key, "dir_cache_dirs") == 0) {
+                parse_int(val, &out->server.dir_cache_dirs);
+                if (out->server.dir_cache_dirs < 0) out->server.dir_cache_dirs = 0;
+            } else if (strcmp(key, "dir_cache_ttl") == 0) {
+                parse_int(val, &out->server.dir_cache_ttl);
+                if (out->server.dir_cache_ttl < 0) out->server.dir_cache_ttl = 0;
+            } else if (strcmp(key, "path_cache_entries") == 0) {
+                parse_int(val, &out->server.path_cache_entries);
+                if (out->server.path_cache_entries < 0) out->server.path_cache_entries = 0;
+            } else if (strcmp(key, "attr_cache_entries") == 0) {
+                parse_int(val, &out->server.attr_cache_entries);
+                if (out->server.attr_cache_entries < 0) out->server.attr_cache_entries = 0;
+            } else if (strcmp(key, "attr_cache_ttl") == 0) {
+                parse_int(val, &out->server.attr_cache_ttl);
+                if (out->server.attr_cache_ttl < 0) out->server.attr_cache_ttl = 0;
             }
         } else if (strcmp(section_kind, "share") == 0 && out->share_count > 0) {
             ras_share_config *c = &out->shares[out->share_count - 1];
@@ -212,6 +333,16 @@ int ras_config_load(const char *path, ras_config *out) {
             } else if (strcmp(key, "default_filetype") == 0 || strcmp(key, "default_type") == 0) {
                 free(c->default_type);
                 c->default_type = ras_strdup(val);
+            } else if (strcmp(key, "write_buffer") == 0) {
+                parse_int(val, &c->write_buffer);
+                if (c->write_buffer < 0) c->write_buffer = 0;
+                if (c->write_buffer > RAS_MAX_WRITE_BUFFER) c->write_buffer = RAS_MAX_WRITE_BUFFER;
+            } else if (strcmp(key, "stat_threads") == 0) {
+                parse_int(val, &c->stat_threads);
+                if (c->stat_threads < 1) c->stat_threads = 1;
+                if (c->stat_threads > RAS_MAX_STAT_THREADS) c->stat_threads = RAS_MAX_STAT_THREADS;
+            } else if (strcmp(key, "metadata") == 0) {
+                c->metadata = str_ieq(val, "xattr") ? RAS_METADATA_XATTR : RAS_METADATA_SUFFIX;
             }
         } else if (strcmp(section_kind, "printer") == 0 && out->printer_count > 0) {
             ras_printer_config *p = &out->printers[out->printer_count - 1];
@@ -239,6 +370,8 @@ int ras_config_load(const char *path, ras_config *out) {
     }
 
     fclose(fp);
+    if (status == 0) status = build_share_index(out);
+    if (status == 0) status = ras_filetype_index_build(out);
     if (status != 0) {
         ras_config_unload(out);
     }
@@ -252,6 +385,7 @@ void ras_config_unload(ras_config *cfg) {
         free_share(&cfg->shares[i]);
     }
     free(cfg->shares);
+    free(cfg->share_index);
 
     for (size_t i = 0; i < cfg->printer_count; ++i) {
         free_printer(&cfg->printers[i]);
@@ -262,12 +396,26 @@ void ras_config_unload(ras_config *cfg) {
         free_mime(&cfg->mimemap[i]);
     }
     free(cfg->mimemap);
+    free(cfg->type_index);
 
     free(cfg->server.log_level);
     free(cfg->server.bind_ip);
     memset(cfg, 0, sizeof(*cfg));
 }
 
+const ras_share_config *ras_config_find_share(const ras_config *cfg, const char *name, size_t len) {
+    if (!cfg || !name || cfg->share_index_size == 0) return NULL;
+    size_t mask = cfg->share_index_size - 1;
+    uint32_t hash = share_hash(name, len);
+    for (size_t slot = hash & mask; cfg->share_index[slot] != 0; slot = (slot + 1) & mask) {
+        const ras_share_config *s = &cfg->shares[cfg->share_index[slot] - 1];
+        if (s->name_hash == hash && s->name_len == len && mem_ieq(s->name, name, len)) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
 int ras_config_validate(const ras_config *cfg) {
     if (!cfg) return -1;
 
@@ -15,12 +15,30 @@
 #define RAS_ATTR_SUBDIR     0x08
 #define RAS_ATTR_CDROM      0x10
 
+#define RAS_MAX_WORKERS     64
+#define RAS_MAX_READ_WINDOW 32
+#define RAS_MAX_READ_CHUNK  8192
+#define RAS_MAX_WRITE_CHUNK 8192
+#define RAS_MAX_WRITE_WINDOW 64
+#define RAS_MAX_WRITE_BUFFER (4 * 1024 * 1024)
+#define RAS_MAX_STAT_THREADS 32
+
+// Where a share keeps RISC OS load/exec addresses and attributes
+#define RAS_METADATA_SUFFIX 0   // Filetype in a ,xxx name suffix, date in mtime
+#define RAS_METADATA_XATTR  1   // In user.riscos.* extended attributes
+
 typedef struct {
     char *name;           // Share name from section
     char *path;           // Local path to share
     uint32_t attributes;  // Parsed attribute flags
     char *password;       // Optional password for protected shares
     char *default_type;   // Default filetype for extensionless files
+    int write_buffer;     // Write-behind bytes per file open for writing (0 = off)
+    int stat_threads;     // Threads stat'ing entries when listing a directory
+    int metadata;         // RAS_METADATA_SUFFIX or RAS_METADATA_XATTR
+    size_t name_len;      // Set once the file is loaded
+    size_t path_len;
+    uint32_t name_hash;   // Of the case-folded name, for the share index
 } ras_share_config;
 
 typedef struct {
@@ -37,25 +55,60 @@ typedef struct {
     char *filetype;       // Hex filetype string
 } ras_mime_entry;
 
+#define RAS_TYPE_EXT_MAX 16
+
+// Extension to filetype, from [mimemap] and the built-in list
+typedef struct {
+    uint32_t hash;
+    uint32_t type;
+    size_t len;                  // 0 = empty slot
+    char ext[RAS_TYPE_EXT_MAX];  // Lowercase
+} ras_type_slot;
+
 typedef struct {
     char *log_level;
     char *bind_ip;           // IP address to bind sockets to (NULL = all interfaces)
     int broadcast_interval;
     int access_plus;
+    int rpc_batch;           // Max RPC datagrams handled per wakeup (1 = unbatched)
+    int workers;             // RPC worker threads, clients sharded by IP
+    int max_transfers;       // Concurrent RREAD/RWRITE transfers per worker
+    int transfer_timeout;    // Seconds before a silent transfer is dropped (0 = never)
+    int read_window;         // D packets in flight per RREAD (1 = ping-pong)
+    int read_chunk;          // D packet payload bytes (0 = from path MTU)
+    int write_chunk;         // Bytes per d packet expected from clients
+    int write_window;        // Chunks requested per w packet
+    int write_reorder_bytes; // Out-of-order d data held per transfer (0 = none)
+    int readahead_bytes;     // Read-ahead buffer per sequentially read handle (0 = off)
+    int reply_cache_entries; // Replies kept per worker for retransmitted requests
+    int reply_cache_bytes;   // Total reply bytes kept per worker
+    int reply_cache_ttl;     // Seconds a reply is replayed for (0 = no cache)
+    int dir_cache_dirs;      // Directory listings kept, shared by all workers
+    int dir_cache_ttl;       // Seconds a listing is trusted without rereading (0 = no cache)
+    int path_cache_entries;  // RISC OS paths whose host path is remembered (0 = no cache)
+    int attr_cache_entries;  // Host files whose stat details are remembered
+    int attr_cache_ttl;      // Seconds those details are trusted (0 = no cache)
 } ras_server_config;
 
 typedef struct {
     ras_server_config server;
     ras_share_config *shares;
     size_t share_count;
+    uint32_t *share_index;   // Open-addressed by name hash: share number + 1, 0 = empty
+    size_t share_index_size; // Power of two, at least twice share_count
     ras_printer_config *printers;
     size_t printer_count;
     ras_mime_entry *mimemap;
     size_t mimemap_count;
+    ras_type_slot *type_index;  // Open-addressed by extension hash
+    size_t type_index_size;     // Power of two, at least twice the extensions
 } ras_config;
 
 int ras_config_load(const char *path, ras_config *out);
 void ras_config_unload(ras_config *cfg);
 int ras_config_validate(const ras_config *cfg);
 
+// Share whose name matches the first len bytes of name, ignoring case
+const ras_share_config *ras_config_find_share(const ras_config *cfg, const char *name, size_t len);
+
 #endif
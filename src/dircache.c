@@ -0,0 +1,370 @@
+// RISC OS Access/ShareFS Server - Directory Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "dircache.h"
+#include "platform.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// Shared by all workers; g_lock guards the table and reference counts
+static ras_mutex g_lock;
+static ras_dir_snapshot **g_buckets = NULL;
+static size_t g_bucket_count = 0;
+static size_t g_count = 0;
+static size_t g_max = 0;
+static uint64_t g_ttl_ms = 0;
+
+static size_t hash_path(const char *path) {
+    uint32_t h = 2166136261u;
+    for (const char *p = path; *p; ++p) {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    return (size_t)h;
+}
+
+int ras_dircache_read_stamp(const char *path, ras_dir_stamp *out) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    memset(out, 0, sizeof(*out));
+    out->dev = (uint64_t)st.st_dev;
+    out->ino = (uint64_t)st.st_ino;
+    out->mtime_sec = (int64_t)st.st_mtime;
+    out->ctime_sec = (int64_t)st.st_ctime;
+#if defined(__APPLE__)
+    out->mtime_nsec = st.st_mtimespec.tv_nsec;
+    out->ctime_nsec = st.st_ctimespec.tv_nsec;
+#elif !defined(_WIN32)
+    out->mtime_nsec = st.st_mtim.tv_nsec;
+    out->ctime_nsec = st.st_ctim.tv_nsec;
+#endif
+    return 0;
+}
+
+static void free_snapshot(ras_dir_snapshot *snap) {
+    free(snap->path);
+    free(snap->data);
+    free(snap->offsets);
+    free(snap->page);
+    free(snap->names);
+    free(snap->name_index);
+    free(snap);
+}
+
+int ras_dircache_init(const ras_config *cfg) {
+    ras_mutex_init(&g_lock);
+    g_max = cfg && cfg->server.dir_cache_dirs > 0 ? (size_t)cfg->server.dir_cache_dirs : 0;
+    g_ttl_ms = cfg && cfg->server.dir_cache_ttl > 0 ? (uint64_t)cfg->server.dir_cache_ttl * 1000u : 0;
+    if (g_max == 0 || g_ttl_ms == 0) {
+        g_max = 0;
+        return 0;
+    }
+    g_bucket_count = 16;
+    while (g_bucket_count < g_max) g_bucket_count <<= 1;
+    g_buckets = (ras_dir_snapshot **)calloc(g_bucket_count, sizeof(ras_dir_snapshot *));
+    if (!g_buckets) {
+        g_max = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void ras_dircache_shutdown(void) {
+    ras_mutex_lock(&g_lock);
+    for (size_t i = 0; i < g_bucket_count; ++i) {
+        ras_dir_snapshot *snap = g_buckets[i];
+        while (snap) {
+            ras_dir_snapshot *next = snap->next;
+            if (--snap->refs == 0) free_snapshot(snap);
+            snap = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = NULL;
+    g_bucket_count = 0;
+    g_count = 0;
+    g_max = 0;
+    ras_mutex_unlock(&g_lock);
+    ras_mutex_destroy(&g_lock);
+}
+
+// Take a snapshot out of the table and drop the table's reference.
+// Caller holds g_lock.
+static void unlink_locked(ras_dir_snapshot **pp) {
+    ras_dir_snapshot *snap = *pp;
+    *pp = snap->next;
+    snap->next = NULL;
+    g_count -= 1;
+    if (--snap->refs == 0) free_snapshot(snap);
+}
+
+static ras_dir_snapshot **find_locked(const char *path) {
+    ras_dir_snapshot **pp = &g_buckets[hash_path(path) & (g_bucket_count - 1)];
+    while (*pp && strcmp((*pp)->path, path) != 0) pp = &(*pp)->next;
+    return pp;
+}
+
+// A listing read in the same second the directory last changed may have
+// missed a later change with the same coarse timestamp, so it is never
+// trusted on the stamp alone
+int ras_dircache_stamp_current(const ras_dir_stamp *seen, int64_t seen_sec, const ras_dir_stamp *now) {
+    return memcmp(seen, now, sizeof(*now)) == 0 &&
+           seen_sec > now->mtime_sec && seen_sec > now->ctime_sec;
+}
+
+static int snapshot_valid(const ras_dir_snapshot *snap, const ras_dir_stamp *stamp, uint64_t now) {
+    return ras_dircache_stamp_current(&snap->stamp, snap->built_sec, stamp) &&
+           now - snap->built_ms <= g_ttl_ms;
+}
+
+static void evict_oldest_locked(void) {
+    ras_dir_snapshot **victim = NULL;
+    for (size_t i = 0; i < g_bucket_count; ++i) {
+        for (ras_dir_snapshot **pp = &g_buckets[i]; *pp; pp = &(*pp)->next) {
+            if (!victim || (*pp)->used_ms < (*victim)->used_ms) victim = pp;
+        }
+    }
+    if (victim) unlink_locked(victim);
+}
+
+ras_dir_snapshot *ras_dircache_get(const char *path, ras_dircache_fill_fn fill, void *ctx) {
+    if (!path || !fill) return NULL;
+
+    ras_dir_stamp stamp;
+    if (ras_dircache_read_stamp(path, &stamp) != 0) return NULL;
+    uint64_t now = ras_monotonic_ms();
+
+    if (g_max > 0) {
+        ras_mutex_lock(&g_lock);
+        ras_dir_snapshot **pp = find_locked(path);
+        if (*pp && snapshot_valid(*pp, &stamp, now)) {
+            ras_dir_snapshot *snap = *pp;
+            snap->refs += 1;
+            snap->used_ms = now;
+            ras_mutex_unlock(&g_lock);
+            return snap;
+        }
+        if (*pp) unlink_locked(pp);
+        ras_mutex_unlock(&g_lock);
+    }
+
+    // Build outside the lock; readers of other directories carry on
+    ras_dir_snapshot *snap = (ras_dir_snapshot *)calloc(1, sizeof(ras_dir_snapshot));
+    if (!snap) return NULL;
+    snap->path = (char *)malloc(strlen(path) + 1);
+    if (!snap->path) {
+        free(snap);
+        return NULL;
+    }
+    strcpy(snap->path, path);
+    snap->stamp = stamp;
+    snap->built_sec = (int64_t)time(NULL);
+    snap->built_ms = now;
+    snap->used_ms = now;
+    snap->refs = 1;
+    if (fill(snap, path, ctx) != 0) {
+        free_snapshot(snap);
+        return NULL;
+    }
+
+    if (g_max > 0) {
+        ras_mutex_lock(&g_lock);
+        ras_dir_snapshot **pp = find_locked(path);
+        if (*pp) unlink_locked(pp);  // Another worker built it meanwhile
+        if (g_count >= g_max) evict_oldest_locked();
+        pp = find_locked(path);
+        snap->next = NULL;
+        *pp = snap;
+        snap->refs += 1;
+        g_count += 1;
+        ras_mutex_unlock(&g_lock);
+    }
+    return snap;
+}
+
+void ras_dircache_release(ras_dir_snapshot *snap) {
+    if (!snap) return;
+    // Without the cache a snapshot never leaves the worker that built it
+    if (g_max > 0) ras_mutex_lock(&g_lock);
+    int last = --snap->refs == 0;
+    if (g_max > 0) ras_mutex_unlock(&g_lock);
+    if (last) free_snapshot(snap);
+}
+
+int ras_dircache_add_entry(ras_dir_snapshot *snap, const void *entry, size_t len) {
+    if (!snap || !entry) return -1;
+    if (snap->len + len > snap->cap) {
+        size_t cap = snap->cap ? snap->cap * 2 : 4096;
+        while (cap < snap->len + len) cap *= 2;
+        unsigned char *p = (unsigned char *)realloc(snap->data, cap);
+        if (!p) return -1;
+        snap->data = p;
+        snap->cap = cap;
+    }
+    if (snap->count == snap->offsets_cap) {
+        size_t cap = snap->offsets_cap ? snap->offsets_cap * 2 : 64;
+        size_t *p = (size_t *)realloc(snap->offsets, cap * sizeof(size_t));
+        if (!p) return -1;
+        snap->offsets = p;
+        snap->offsets_cap = cap;
+    }
+    memcpy(snap->data + snap->len, entry, len);
+    snap->offsets[snap->count++] = snap->len;
+    snap->len += len;
+    return 0;
+}
+
+size_t ras_dircache_entry(const ras_dir_snapshot *snap, size_t i, const unsigned char **entry) {
+    size_t end = i + 1 < snap->count ? snap->offsets[i + 1] : snap->len;
+    *entry = snap->data + snap->offsets[i];
+    return end - snap->offsets[i];
+}
+
+// Entry pointer first, so the caller's comparator can treat a slot as
+// a pointer to the entry
+typedef struct {
+    const unsigned char *entry;
+    size_t len;
+} sort_slot;
+
+int ras_dircache_sort(ras_dir_snapshot *snap, int (*cmp)(const void *, const void *)) {
+    if (!snap || !cmp) return -1;
+    if (snap->count < 2) return 0;
+
+    sort_slot *slots = (sort_slot *)malloc(snap->count * sizeof(*slots));
+    unsigned char *data = (unsigned char *)malloc(snap->cap);
+    if (!slots || !data) {
+        free(slots);
+        free(data);
+        return -1;
+    }
+    for (size_t i = 0; i < snap->count; ++i) {
+        slots[i].len = ras_dircache_entry(snap, i, &slots[i].entry);
+    }
+    qsort(slots, snap->count, sizeof(*slots), cmp);
+
+    size_t len = 0;
+    for (size_t i = 0; i < snap->count; ++i) {
+        memcpy(data + len, slots[i].entry, slots[i].len);
+        snap->offsets[i] = len;
+        len += slots[i].len;
+    }
+    free(slots);
+    free(snap->data);
+    snap->data = data;
+    return 0;
+}
+
+static uint32_t hash_folded(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint32_t)tolower((unsigned char)s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int folded_equal(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return 0;
+    }
+    return 1;
+}
+
+static size_t find_name_slot(const ras_dir_snapshot *snap, const char *base, size_t base_len, uint32_t hash) {
+    size_t mask = snap->name_index_size - 1;
+    size_t slot = hash & mask;
+    for (;;) {
+        const ras_dir_name *n = &snap->name_index[slot];
+        if (n->base_len == 0) return slot;
+        if (n->hash == hash && n->base_len == base_len &&
+            folded_equal(snap->names + n->base, base, base_len)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static int grow_name_index(ras_dir_snapshot *snap) {
+    size_t size = snap->name_index_size ? snap->name_index_size * 2 : 64;
+    ras_dir_name *index = (ras_dir_name *)calloc(size, sizeof(ras_dir_name));
+    if (!index) return -1;
+    ras_dir_name *old = snap->name_index;
+    size_t old_size = snap->name_index_size;
+    snap->name_index = index;
+    snap->name_index_size = size;
+    for (size_t i = 0; i < old_size; ++i) {
+        if (old[i].base_len == 0) continue;
+        size_t slot = old[i].hash & (size - 1);
+        while (index[slot].base_len != 0) slot = (slot + 1) & (size - 1);
+        index[slot] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+int ras_dircache_add_host_name(ras_dir_snapshot *snap, const char *base, size_t base_len, const char *host_name) {
+    if (!snap || !base || !host_name || base_len == 0) return -1;
+    if ((snap->name_count + 1) * 2 > snap->name_index_size && grow_name_index(snap) != 0) return -1;
+
+    uint32_t hash = hash_folded(base, base_len);
+    size_t slot = find_name_slot(snap, base, base_len, hash);
+    if (snap->name_index[slot].base_len != 0) return 0;
+
+    size_t host_len = strlen(host_name) + 1;
+    size_t need = snap->names_len + base_len + host_len;
+    if (need > snap->names_cap) {
+        size_t cap = snap->names_cap ? snap->names_cap * 2 : 4096;
+        while (cap < need) cap *= 2;
+        char *p = (char *)realloc(snap->names, cap);
+        if (!p) return -1;
+        snap->names = p;
+        snap->names_cap = cap;
+    }
+    ras_dir_name *n = &snap->name_index[slot];
+    n->hash = hash;
+    n->base_len = (uint32_t)base_len;
+    n->base = snap->names_len;
+    memcpy(snap->names + snap->names_len, base, base_len);
+    snap->names_len += base_len;
+    n->host = snap->names_len;
+    memcpy(snap->names + snap->names_len, host_name, host_len);
+    snap->names_len += host_len;
+    snap->name_count += 1;
+    return 0;
+}
+
+const char *ras_dircache_host_name(const ras_dir_snapshot *snap, const char *base, size_t base_len) {
+    if (!snap || !base || base_len == 0 || snap->name_count == 0) return NULL;
+    const ras_dir_name *n = &snap->name_index[find_name_slot(snap, base, base_len, hash_folded(base, base_len))];
+    return n->base_len != 0 ? snap->names + n->host : NULL;
+}
+
+int ras_dircache_enabled(void) {
+    return g_max > 0;
+}
+
+void ras_dircache_invalidate(const char *path) {
+    if (!path || g_max == 0) return;
+    ras_mutex_lock(&g_lock);
+    ras_dir_snapshot **pp = find_locked(path);
+    if (*pp) unlink_locked(pp);
+    ras_mutex_unlock(&g_lock);
+}
+
+void ras_dircache_invalidate_parent(const char *path) {
+    if (!path || g_max == 0) return;
+    const char *slash = strrchr(path, '/');
+    if (!slash || slash == path) return;
+    char parent[512];
+    size_t n = (size_t)(slash - path);
+    if (n >= sizeof(parent)) return;
+    memcpy(parent, path, n);
+    parent[n] = '\0';
+    ras_dircache_invalidate(parent);
+}
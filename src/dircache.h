@@ -0,0 +1,105 @@
+// RISC OS Access/ShareFS Server - Directory Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_DIRCACHE_H
+#define RAS_DIRCACHE_H
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Identity and change stamp of a directory; any difference means the
+// listing may have changed
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    long mtime_nsec;
+    int64_t ctime_sec;
+    long ctime_nsec;
+} ras_dir_stamp;
+
+// Slot in a snapshot's host name index, empty while base_len is 0
+typedef struct {
+    uint32_t hash;                  // Of the case-folded base name
+    uint32_t base_len;
+    size_t base;                    // Offsets into the snapshot's names pool
+    size_t host;
+} ras_dir_name;
+
+// Directory listing in wire format: each entry is FileDesc(20) + name +
+// NUL, padded to 4 bytes. Immutable once published, so it is read
+// without locking; the reference count keeps it alive while in use.
+typedef struct ras_dir_snapshot {
+    struct ras_dir_snapshot *next;  // Hash chain
+    char *path;
+    ras_dir_stamp stamp;
+    int64_t built_sec;              // Wall clock when the listing was read
+    uint64_t built_ms;
+    uint64_t used_ms;
+    int refs;                       // One per user, plus one while cached
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t *offsets;                // Start of each entry in data
+    size_t count;
+    size_t offsets_cap;
+    unsigned char *page;            // First catalogue reply, encoded by the fill
+    size_t page_len;                // function with blank per-request fields
+    size_t page_next;               // First entry not in page
+    char *names;                    // Base and host names for name_index
+    size_t names_len;
+    size_t names_cap;
+    ras_dir_name *name_index;       // Open-addressed, power-of-two size
+    size_t name_index_size;
+    size_t name_count;
+} ras_dir_snapshot;
+
+// Current stamp of the directory at path
+int ras_dircache_read_stamp(const char *path, ras_dir_stamp *out);
+
+// Whether a directory stamped seen at wall-clock second seen_sec is
+// known to be unchanged, given its stamp now
+int ras_dircache_stamp_current(const ras_dir_stamp *seen, int64_t seen_sec, const ras_dir_stamp *now);
+
+// Reads the directory at path into snap with ras_dircache_add_entry()
+typedef int (*ras_dircache_fill_fn)(ras_dir_snapshot *snap, const char *path, void *ctx);
+
+// Size and lifetime settings from the [server] section
+int ras_dircache_init(const ras_config *cfg);
+void ras_dircache_shutdown(void);
+
+// Listing of a directory, from the cache if the directory is unchanged,
+// else built with fill. Release it with ras_dircache_release().
+ras_dir_snapshot *ras_dircache_get(const char *path, ras_dircache_fill_fn fill, void *ctx);
+void ras_dircache_release(ras_dir_snapshot *snap);
+
+// Append one wire-format entry while filling a snapshot
+int ras_dircache_add_entry(ras_dir_snapshot *snap, const void *entry, size_t len);
+
+// Entry i of a snapshot; returns its padded length
+size_t ras_dircache_entry(const ras_dir_snapshot *snap, size_t i, const unsigned char **entry);
+
+// Reorder a snapshot's entries while filling it. cmp is a qsort()
+// comparator whose arguments point to pointers to entries.
+int ras_dircache_sort(ras_dir_snapshot *snap, int (*cmp)(const void *, const void *));
+
+// Record, while filling, that base name (ignoring case) is stored on
+// disk as host_name; the first name added for a base wins
+int ras_dircache_add_host_name(ras_dir_snapshot *snap, const char *base, size_t base_len, const char *host_name);
+
+// On-disk name recorded for base, or NULL
+const char *ras_dircache_host_name(const ras_dir_snapshot *snap, const char *base, size_t base_len);
+
+// Whether listings outlive the request that reads them
+int ras_dircache_enabled(void);
+
+// Forget the listing of a directory after changing something in it
+void ras_dircache_invalidate(const char *path);
+
+// Forget the listing of the directory containing path
+void ras_dircache_invalidate_parent(const char *path);
+
+#endif
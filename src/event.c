@@ -0,0 +1,271 @@
+// RISC OS Access/ShareFS Server - Event Loop
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "event.h"
+#include "log.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef RAS_HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#elif !defined(_WIN32)
+#include <sys/select.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// epoll user data: high word distinguishes sockets from timers
+#define EV_KIND_FD    1u
+#define EV_KIND_TIMER 2u
+#define EV_KIND_WAKE  3u
+
+int ras_event_init(ras_event_loop *loop) {
+    if (!loop) return -1;
+    memset(loop, 0, sizeof(*loop));
+#ifdef RAS_HAVE_EPOLL
+    loop->epfd = -1;
+#endif
+#ifndef _WIN32
+    if (pipe(loop->wake) != 0) return -1;
+    fcntl(loop->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(loop->wake[1], F_SETFL, O_NONBLOCK);
+#endif
+#ifdef RAS_HAVE_EPOLL
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        close(loop->wake[0]);
+        close(loop->wake[1]);
+        return -1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = (uint64_t)EV_KIND_WAKE << 32;
+    epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wake[0], &ev);
+#endif
+    return 0;
+}
+
+void ras_event_free(ras_event_loop *loop) {
+    if (!loop) return;
+#ifdef RAS_HAVE_EPOLL
+    for (size_t i = 0; i < loop->timer_count; ++i) {
+        if (loop->timers[i].tfd >= 0) close(loop->timers[i].tfd);
+    }
+    if (loop->epfd >= 0) close(loop->epfd);
+#endif
+#ifndef _WIN32
+    close(loop->wake[0]);
+    close(loop->wake[1]);
+#endif
+    memset(loop, 0, sizeof(*loop));
+}
+
+const char *ras_event_backend(void) {
+#ifdef RAS_HAVE_EPOLL
+    return "epoll";
+#else
+    return "select";
+#endif
+}
+
+int ras_event_add_fd(ras_event_loop *loop, ras_socket s, ras_event_fd_fn fn, void *ctx) {
+    if (!loop || !fn || s == RAS_INVALID_SOCKET) return -1;
+    if (loop->fd_count >= RAS_EVENT_MAX_FDS) return -1;
+
+    size_t idx = loop->fd_count;
+#ifdef RAS_HAVE_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t)EV_KIND_FD << 32) | idx;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, s, &ev) != 0) return -1;
+#endif
+    loop->fds[idx].s = s;
+    loop->fds[idx].fn = fn;
+    loop->fds[idx].ctx = ctx;
+    loop->fd_count++;
+    return 0;
+}
+
+int ras_event_add_timer(ras_event_loop *loop, ras_event_timer_fn fn, void *ctx) {
+    if (!loop || !fn) return -1;
+    if (loop->timer_count >= RAS_EVENT_MAX_TIMERS) return -1;
+
+    size_t idx = loop->timer_count;
+    ras_event_timer *t = &loop->timers[idx];
+    memset(t, 0, sizeof(*t));
+#ifdef RAS_HAVE_EPOLL
+    t->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (t->tfd < 0) return -1;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t)EV_KIND_TIMER << 32) | idx;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, t->tfd, &ev) != 0) {
+        close(t->tfd);
+        return -1;
+    }
+#endif
+    t->fn = fn;
+    t->ctx = ctx;
+    loop->timer_count++;
+    return (int)idx;
+}
+
+int ras_event_arm_timer(ras_event_loop *loop, int id, uint64_t delay_ms, uint64_t interval_ms) {
+    if (!loop || id < 0 || (size_t)id >= loop->timer_count) return -1;
+    ras_event_timer *t = &loop->timers[id];
+
+#ifdef RAS_HAVE_EPOLL
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = (time_t)(delay_ms / 1000);
+    its.it_value.tv_nsec = (long)(delay_ms % 1000) * 1000000L;
+    its.it_interval.tv_sec = (time_t)(interval_ms / 1000);
+    its.it_interval.tv_nsec = (long)(interval_ms % 1000) * 1000000L;
+    if (timerfd_settime(t->tfd, 0, &its, NULL) != 0) return -1;
+#endif
+    t->armed = delay_ms > 0;
+    t->interval_ms = interval_ms;
+    t->deadline_ms = ras_monotonic_ms() + delay_ms;
+    return 0;
+}
+
+int ras_event_timer_armed(const ras_event_loop *loop, int id) {
+    if (!loop || id < 0 || (size_t)id >= loop->timer_count) return 0;
+    return loop->timers[id].armed;
+}
+
+void ras_event_stop(ras_event_loop *loop) {
+    if (!loop) return;
+    loop->stop = 1;
+#ifndef _WIN32
+    char c = 1;
+    if (write(loop->wake[1], &c, 1) < 0) {
+        // Pipe full: a wakeup is already pending
+    }
+#endif
+}
+
+#ifndef _WIN32
+static void drain_wake(ras_event_loop *loop) {
+    char buf[16];
+    while (read(loop->wake[0], buf, sizeof(buf)) > 0) {
+    }
+}
+#endif
+
+static void fire_timer(ras_event_loop *loop, size_t idx) {
+    ras_event_timer *t = &loop->timers[idx];
+    if (!t->armed) return;
+    if (t->interval_ms > 0) {
+        t->deadline_ms += t->interval_ms;
+    } else {
+        t->armed = 0;
+    }
+    // Callback may re-arm or disarm any timer, including this one
+    t->fn(t->ctx);
+}
+
+#ifdef RAS_HAVE_EPOLL
+
+int ras_event_run(ras_event_loop *loop) {
+    if (!loop) return -1;
+    struct epoll_event events[RAS_EVENT_MAX_FDS + RAS_EVENT_MAX_TIMERS + 1];
+
+    while (!loop->stop) {
+        int n = epoll_wait(loop->epfd, events, (int)(sizeof(events) / sizeof(events[0])), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ras_log(RAS_LOG_ERROR, "epoll_wait failed: errno=%d", errno);
+            return -1;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            uint32_t kind = (uint32_t)(events[i].data.u64 >> 32);
+            size_t idx = (size_t)(events[i].data.u64 & 0xFFFFFFFFu);
+            if (kind == EV_KIND_FD) {
+                ras_event_fd *f = &loop->fds[idx];
+                f->fn(f->s, f->ctx);
+            } else if (kind == EV_KIND_TIMER) {
+                uint64_t expirations = 0;
+                // Drain the timerfd; a stale wakeup after re-arming reads nothing
+                if (read(loop->timers[idx].tfd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations)) {
+                    continue;
+                }
+                fire_timer(loop, idx);
+            } else if (kind == EV_KIND_WAKE) {
+                drain_wake(loop);
+            }
+        }
+    }
+    return 0;
+}
+
+#else
+
+int ras_event_run(ras_event_loop *loop) {
+    if (!loop) return -1;
+
+    while (!loop->stop) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        ras_socket maxfd = 0;
+#ifndef _WIN32
+        FD_SET(loop->wake[0], &fds);
+        maxfd = loop->wake[0];
+#endif
+        for (size_t i = 0; i < loop->fd_count; ++i) {
+            FD_SET(loop->fds[i].s, &fds);
+            if (loop->fds[i].s > maxfd) maxfd = loop->fds[i].s;
+        }
+
+        // Sleep until the nearest armed timer, or indefinitely if none
+        uint64_t now = ras_monotonic_ms();
+        int have_deadline = 0;
+        uint64_t wait_ms = 0;
+        for (size_t i = 0; i < loop->timer_count; ++i) {
+            const ras_event_timer *t = &loop->timers[i];
+            if (!t->armed) continue;
+            uint64_t left = t->deadline_ms > now ? t->deadline_ms - now : 0;
+            if (!have_deadline || left < wait_ms) wait_ms = left;
+            have_deadline = 1;
+        }
+
+        struct timeval tv;
+        tv.tv_sec = (long)(wait_ms / 1000);
+        tv.tv_usec = (long)(wait_ms % 1000) * 1000L;
+
+        int ready = select((int)(maxfd + 1), &fds, NULL, NULL, have_deadline ? &tv : NULL);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            ras_log(RAS_LOG_ERROR, "select failed: errno=%d", errno);
+            return -1;
+        }
+
+#ifndef _WIN32
+        if (FD_ISSET(loop->wake[0], &fds)) drain_wake(loop);
+#endif
+        for (size_t i = 0; ready > 0 && i < loop->fd_count; ++i) {
+            if (FD_ISSET(loop->fds[i].s, &fds)) {
+                loop->fds[i].fn(loop->fds[i].s, loop->fds[i].ctx);
+            }
+        }
+
+        now = ras_monotonic_ms();
+        for (size_t i = 0; i < loop->timer_count; ++i) {
+            if (loop->timers[i].armed && loop->timers[i].deadline_ms <= now) {
+                fire_timer(loop, i);
+            }
+        }
+    }
+    return 0;
+}
+
+#endif
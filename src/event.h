@@ -0,0 +1,72 @@
+// RISC OS Access/ShareFS Server - Event Loop
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_EVENT_H
+#define RAS_EVENT_H
+
+#include "platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RAS_EVENT_MAX_FDS    8
+#define RAS_EVENT_MAX_TIMERS 8
+
+typedef void (*ras_event_fd_fn)(ras_socket s, void *ctx);
+typedef void (*ras_event_timer_fn)(void *ctx);
+
+typedef struct {
+    ras_socket s;
+    ras_event_fd_fn fn;
+    void *ctx;
+} ras_event_fd;
+
+typedef struct {
+    int armed;
+    uint64_t interval_ms;  // Period for repeating timers, 0 for one-shot
+    uint64_t deadline_ms;  // Next expiry on the monotonic clock
+    ras_event_timer_fn fn;
+    void *ctx;
+#ifdef RAS_HAVE_EPOLL
+    int tfd;               // timerfd backing this timer
+#endif
+} ras_event_timer;
+
+// Sockets and timers are dispatched from epoll/timerfd on Linux, or from
+// select() with a timeout derived from the nearest timer elsewhere.
+typedef struct {
+    ras_event_fd fds[RAS_EVENT_MAX_FDS];
+    size_t fd_count;
+    ras_event_timer timers[RAS_EVENT_MAX_TIMERS];
+    size_t timer_count;
+    volatile int stop;
+#ifndef _WIN32
+    int wake[2];           // Self-pipe so ras_event_stop() works across threads
+#endif
+#ifdef RAS_HAVE_EPOLL
+    int epfd;
+#endif
+} ras_event_loop;
+
+int ras_event_init(ras_event_loop *loop);
+void ras_event_free(ras_event_loop *loop);
+const char *ras_event_backend(void);
+
+// Watch a socket for readability
+int ras_event_add_fd(ras_event_loop *loop, ras_socket s, ras_event_fd_fn fn, void *ctx);
+
+// Register a timer (initially disarmed), returns its id or -1
+int ras_event_add_timer(ras_event_loop *loop, ras_event_timer_fn fn, void *ctx);
+
+// Arm a timer to fire after delay_ms and then every interval_ms (0 = once).
+// A delay of 0 disarms the timer.
+int ras_event_arm_timer(ras_event_loop *loop, int id, uint64_t delay_ms, uint64_t interval_ms);
+int ras_event_timer_armed(const ras_event_loop *loop, int id);
+
+// Dispatch events until ras_event_stop() is called or a fatal error occurs.
+// ras_event_stop() may be called from another thread.
+int ras_event_run(ras_event_loop *loop);
+void ras_event_stop(ras_event_loop *loop);
+
+#endif
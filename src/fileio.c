@@ -0,0 +1,235 @@
+// RISC OS Access/ShareFS Server - File Data I/O
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "fileio.h"
+#include "attrcache.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reads continuing the previous one before a handle counts as sequential
+#define SEQUENTIAL_STREAK 2
+
+// Buffered data older than this may be stale if another handle wrote the file
+#define READAHEAD_MAX_AGE_MS 1000
+
+static size_t g_readahead_bytes = 0;
+
+void ras_fileio_init(const ras_config *cfg) {
+    g_readahead_bytes = cfg && cfg->server.readahead_bytes > 0 ? (size_t)cfg->server.readahead_bytes : 0;
+}
+
+static void advise(int fd, uint32_t pos, size_t len, int sequential) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (sequential) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    } else {
+        posix_fadvise(fd, (off_t)pos, (off_t)len, POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)fd;
+    (void)pos;
+    (void)len;
+    (void)sequential;
+#endif
+}
+
+static int buffer_valid(const ras_handle *h, uint64_t now) {
+    return h->ra_buf && h->ra_len > 0 && now - h->ra_filled_ms <= READAHEAD_MAX_AGE_MS;
+}
+
+// Load g_readahead_bytes from pos into the buffer and hint the block after
+static int refill(ras_handle *h, uint32_t pos, uint64_t now) {
+    if (!h->ra_buf) {
+        h->ra_buf = (unsigned char *)malloc(g_readahead_bytes);
+        if (!h->ra_buf) return -1;
+        advise(h->fd, 0, 0, 1);
+    }
+    ssize_t n = ras_pread(h->fd, h->ra_buf, g_readahead_bytes, pos);
+    if (n < 0) {
+        h->ra_len = 0;
+        return -1;
+    }
+    h->ra_pos = pos;
+    h->ra_len = (uint32_t)n;
+    h->ra_filled_ms = now;
+    if ((size_t)n == g_readahead_bytes) {
+        advise(h->fd, pos + (uint32_t)n, g_readahead_bytes, 0);
+    }
+    return 0;
+}
+
+ssize_t ras_fileio_read(ras_handle *h, void *buf, size_t len, uint32_t pos) {
+    if (!h || h->fd < 0 || !buf) return -1;
+    if (h->wb_len > 0 && ras_fileio_flush(h) != 0) return -1;
+
+    if (pos == h->ra_next) {
+        h->ra_streak++;
+        h->ra_next = pos + (uint32_t)len;
+    } else if (!(h->ra_len > 0 && pos >= h->ra_pos && pos < h->ra_next)) {
+        // Not a resend of data already streamed: start over
+        h->ra_streak = 0;
+        h->ra_next = pos + (uint32_t)len;
+    }
+
+    if (g_readahead_bytes == 0 || len > g_readahead_bytes || h->ra_streak < SEQUENTIAL_STREAK) {
+        return ras_pread(h->fd, buf, len, pos);
+    }
+
+    uint64_t now = ras_monotonic_ms();
+    int covered = buffer_valid(h, now) && pos >= h->ra_pos &&
+                  (uint64_t)pos + len <= (uint64_t)h->ra_pos + h->ra_len;
+    // A short buffer ends at end of file, so it also answers reads past it
+    int at_eof = buffer_valid(h, now) && h->ra_len < g_readahead_bytes &&
+                 pos >= h->ra_pos && pos <= h->ra_pos + h->ra_len;
+    if (!covered && !at_eof && refill(h, pos, now) != 0) {
+        return ras_pread(h->fd, buf, len, pos);
+    }
+
+    uint32_t avail = h->ra_pos + h->ra_len - pos;
+    if (len > avail) len = avail;
+    memcpy(buf, h->ra_buf + (pos - h->ra_pos), len);
+    return (ssize_t)len;
+}
+
+void ras_fileio_prefetch(ras_handle *h, uint32_t next_pos) {
+    if (!h || h->fd < 0 || g_readahead_bytes == 0) return;
+    if (h->ra_streak < SEQUENTIAL_STREAK || next_pos != h->ra_next) return;
+
+    // Keep at least half a buffer ready beyond the next window's start
+    uint64_t now = ras_monotonic_ms();
+    if (buffer_valid(h, now) && next_pos >= h->ra_pos &&
+        (uint64_t)next_pos + g_readahead_bytes / 2 <= (uint64_t)h->ra_pos + h->ra_len) {
+        return;
+    }
+    if (buffer_valid(h, now) && h->ra_len < g_readahead_bytes && next_pos >= h->ra_pos) {
+        return;  // Buffer already reaches end of file
+    }
+    refill(h, next_pos, now);
+}
+
+void ras_fileio_invalidate(ras_handle *h) {
+    if (!h) return;
+    h->ra_len = 0;
+}
+
+// Gather write that must complete in full. Returns 0, or -1 with errno set.
+static int write_all(int fd, const ras_iovec *iov, int count, uint32_t pos) {
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) total += iov[i].len;
+    if (total == 0) return 0;
+    ssize_t n = ras_pwritev(fd, iov, count, pos);
+    if (n < 0) return -1;
+    if ((size_t)n < total) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return 0;
+}
+
+int ras_fileio_flush(ras_handle *h) {
+    if (!h) return 0;
+    if (h->wb_len > 0) {
+        ras_iovec v = { h->wb_buf, h->wb_len };
+        uint32_t len = h->wb_len;
+        h->wb_len = 0;
+        int rc = write_all(h->fd, &v, 1, h->wb_pos);
+        // The write may land after the RWRITE that queued it has finished,
+        // so details cached since then are out of date
+        ras_attrcache_invalidate(h->path);
+        if (rc != 0) {
+            ras_log(RAS_LOG_ERROR, "write-behind of %u bytes at %u failed: errno=%d", len, h->wb_pos, errno);
+            return -1;
+        }
+    }
+    if (h->wb_error != 0) {
+        errno = h->wb_error;
+        h->wb_error = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int ras_fileio_write(ras_handle_table *t, ras_handle *h, const ras_iovec *iov, int count, uint32_t pos) {
+    if (!h || h->fd < 0 || count < 0 || count > RAS_MAX_IOV) {
+        errno = EBADF;
+        return -1;
+    }
+    ras_fileio_invalidate(h);
+    h->written = 1;
+
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) total += iov[i].len;
+    if (total == 0) return 0;
+
+    // Not a continuation of the buffered run: write that out first
+    if (h->wb_len > 0 && pos != h->wb_pos + h->wb_len && ras_fileio_flush(h) != 0) return -1;
+
+    if (h->wb_cap > 0 && !h->wb_buf && total < h->wb_cap) {
+        h->wb_buf = (unsigned char *)malloc(h->wb_cap);
+    }
+    if (!h->wb_buf) return write_all(h->fd, iov, count, pos);
+
+    if (h->wb_len + total < h->wb_cap) {
+        if (h->wb_len == 0) {
+            h->wb_pos = pos;
+            h->wb_since_ms = ras_monotonic_ms();
+            if (t) t->write_behind = 1;
+        }
+        for (int i = 0; i < count; ++i) {
+            memcpy(h->wb_buf + h->wb_len, iov[i].base, iov[i].len);
+            h->wb_len += (uint32_t)iov[i].len;
+        }
+        return 0;
+    }
+
+    // Threshold reached: the buffered run and the new data in one call
+    if (h->wb_len > 0 && count == RAS_MAX_IOV && ras_fileio_flush(h) != 0) return -1;
+    ras_iovec v[RAS_MAX_IOV];
+    int n = 0;
+    uint32_t start = pos;
+    if (h->wb_len > 0) {
+        v[n].base = h->wb_buf;
+        v[n].len = h->wb_len;
+        n++;
+        start = h->wb_pos;
+    }
+    for (int i = 0; i < count; ++i) v[n++] = iov[i];
+    int flushed = h->wb_len > 0;
+    h->wb_len = 0;
+    int rc = write_all(h->fd, v, n, start);
+    if (flushed) ras_attrcache_invalidate(h->path);
+    return rc;
+}
+
+void ras_fileio_flush_idle(ras_handle_table *t, uint64_t max_age_ms) {
+    if (!t) return;
+    uint64_t now = ras_monotonic_ms();
+    int pending = 0;
+    for (size_t i = 0; i < t->capacity; ++i) {
+        ras_handle *h = &t->slots[i];
+        if (h->id == 0 || h->wb_len == 0) continue;
+        if (now - h->wb_since_ms < max_age_ms) {
+            pending = 1;
+        } else if (ras_fileio_flush(h) != 0) {
+            // Nobody is waiting on this write: hold the error for RCLOSE
+            h->wb_error = errno;
+        }
+    }
+    t->write_behind = pending;
+}
+
+void ras_fileio_release(ras_handle *h) {
+    if (!h) return;
+    if (h->wb_len > 0 && h->fd >= 0) ras_fileio_flush(h);
+    free(h->ra_buf);
+    free(h->wb_buf);
+    h->ra_buf = NULL;
+    h->wb_buf = NULL;
+    h->ra_len = 0;
+    h->wb_len = 0;
+}
@@ -0,0 +1,48 @@
+// RISC OS Access/ShareFS Server - File Data I/O
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_FILEIO_H
+#define RAS_FILEIO_H
+
+#include "config.h"
+#include "handle.h"
+#include "platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buffered write data reaches the file at most this long after it arrives
+#define RAS_FILEIO_FLUSH_MS 500
+
+// Read-ahead settings from the [server] section
+void ras_fileio_init(const ras_config *cfg);
+
+// Read file data for a handle. Once a handle is read sequentially, reads
+// are served from a per-handle read-ahead buffer refilled in large blocks.
+ssize_t ras_fileio_read(ras_handle *h, void *buf, size_t len, uint32_t pos);
+
+// A read window has gone out and the next one will start at next_pos:
+// refill the buffer now so the disk works while the client acks
+void ras_fileio_prefetch(ras_handle *h, uint32_t next_pos);
+
+// Drop buffered data after the file was written or resized
+void ras_fileio_invalidate(ras_handle *h);
+
+// Write file data for a handle. Contiguous writes are collected in the
+// handle's write-behind buffer (wb_cap bytes) and written out together,
+// so data may reach the file later. Returns 0, or -1 with errno set.
+int ras_fileio_write(ras_handle_table *t, ras_handle *h, const ras_iovec *iov, int count, uint32_t pos);
+
+// Write out buffered data now. Also reports a failed background flush.
+// Returns 0, or -1 with errno set.
+int ras_fileio_flush(ras_handle *h);
+
+// Flush buffers holding data for at least max_age_ms (0 = all) and
+// refresh t->write_behind
+void ras_fileio_flush_idle(ras_handle_table *t, uint64_t max_age_ms);
+
+// Flush and free a handle's buffers before it is closed
+void ras_fileio_release(ras_handle *h);
+
+#endif
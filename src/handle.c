@@ -3,30 +3,118 @@
 // License: GPL-3.0-only
 
 #include "handle.h"
+#include "dircache.h"
+#include "fileio.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-static int make_token(void) {
-    return (rand() & 0x7fff) + 1;
+#define INITIAL_SLOTS 16
+
+// Tables belong to one worker each, so tokens come from a per-table
+// xorshift rather than the shared rand() state
+static int make_token(ras_handle_table *t) {
+    uint32_t x = t->token_seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t->token_seed = x;
+    return (int)(x & 0x7fff) + 1;
+}
+
+static void seed_tokens(ras_handle_table *t, uint32_t mix) {
+    uint32_t seed = (uint32_t)time(NULL) ^ (uint32_t)(uintptr_t)t ^ (mix * 0x9E3779B9u);
+    t->token_seed = seed ? seed : 0x2545F491u;
+}
+
+static int make_id(const ras_handle_table *t, size_t slot, uint8_t generation) {
+    return t->id_base | ((int)generation << RAS_HANDLE_GEN_SHIFT) | (int)(slot + 1);
+}
+
+// Map an ID back to its slot, or NULL if the ID is stale or out of range
+static ras_handle *slot_for_id(ras_handle_table *t, int id) {
+    if (!t || id <= 0) return NULL;
+    size_t slot = (size_t)(id & RAS_HANDLE_SLOT_MASK);
+    if (slot == 0 || slot > t->capacity) return NULL;
+    ras_handle *h = &t->slots[slot - 1];
+    return h->id == id ? h : NULL;
+}
+
+static int grow_slots(ras_handle_table *t) {
+    size_t n = t->capacity ? t->capacity * 2 : INITIAL_SLOTS;
+    if (n > RAS_HANDLE_MAX_SLOTS) n = RAS_HANDLE_MAX_SLOTS;
+    if (n <= t->capacity) return -1;
+    ras_handle *p = (ras_handle *)realloc(t->slots, n * sizeof(ras_handle));
+    if (!p) return -1;
+    memset(&p[t->capacity], 0, (n - t->capacity) * sizeof(ras_handle));
+    // Chain the new slots onto the free list in ascending order
+    for (size_t i = t->capacity; i < n; ++i) {
+        p[i].next_free = (i + 1 < n) ? (int)(i + 1) : t->free_head;
+        p[i].generation = 1;
+    }
+    t->free_head = (int)t->capacity;
+    t->slots = p;
+    t->capacity = n;
+    return 0;
+}
+
+static void track_dead(ras_handle_table *t, int id) {
+    if (t->dead_count == t->dead_cap) {
+        size_t n = t->dead_cap ? t->dead_cap * 2 : 16;
+        int *d = (int *)realloc(t->dead_handles, n * sizeof(int));
+        if (!d) return;
+        t->dead_handles = d;
+        t->dead_cap = n;
+    }
+    t->dead_handles[t->dead_count++] = id;
+}
+
+// Return a slot to the free list, invalidating outstanding IDs for it
+static void release_slot(ras_handle_table *t, ras_handle *h) {
+    size_t slot = (size_t)(h - t->slots);
+    free(h->path);
+    ras_fileio_release(h);
+    if (h->listing) ras_dircache_release(h->listing);
+    if (h->dir_fd >= 0) close(h->dir_fd);
+    uint8_t generation = (uint8_t)(h->generation + 1);
+    if (generation == 0) generation = 1;
+    memset(h, 0, sizeof(*h));
+    h->generation = generation;
+    h->next_free = t->free_head;
+    t->free_head = (int)slot;
+    t->count -= 1;
 }
 
 int ras_handles_init(ras_handle_table *t) {
     if (!t) return -1;
     memset(t, 0, sizeof(*t));
-    t->next_id = 1; // 0 reserved for root
+    t->free_head = -1;
+    seed_tokens(t, 0);
     return 0;
 }
 
+void ras_handles_set_worker(ras_handle_table *t, int worker) {
+    if (!t || worker < 0) return;
+    t->id_base = worker << RAS_HANDLE_WORKER_SHIFT;
+    seed_tokens(t, (uint32_t)worker);
+}
+
 void ras_handles_free(ras_handle_table *t) {
     if (!t) return;
-    for (size_t i = 0; i < t->count; ++i) {
-        free(t->items[i].path);
+    for (size_t i = 0; i < t->capacity; ++i) {
+        if (t->slots[i].id != 0) {
+            free(t->slots[i].path);
+            ras_fileio_release(&t->slots[i]);
+            if (t->slots[i].listing) ras_dircache_release(t->slots[i].listing);
+            if (t->slots[i].dir_fd >= 0) close(t->slots[i].dir_fd);
+        }
     }
-    free(t->items);
+    free(t->slots);
     free(t->dead_handles);
     memset(t, 0, sizeof(*t));
+    t->free_head = -1;
 }
 
 int ras_handles_add(ras_handle_table *t, ras_handle_type type, int fd, int *out_id, int *out_token) {
@@ -37,16 +125,21 @@ int ras_handles_add_ex(ras_handle_table *t, ras_handle_type type, int fd, const
                        uint32_t load, uint32_t exec, uint32_t len, uint32_t attrs,
                        int *out_id, int *out_token) {
     if (!t) return -1;
-    size_t n = t->count + 1;
-    ras_handle *p = (ras_handle *)realloc(t->items, n * sizeof(ras_handle));
-    if (!p) return -1;
-    t->items = p;
-    ras_handle *h = &t->items[n - 1];
+    if (t->free_head < 0 && grow_slots(t) != 0) return -1;
+
+    size_t slot = (size_t)t->free_head;
+    ras_handle *h = &t->slots[slot];
+    t->free_head = h->next_free;
+
+    uint8_t generation = h->generation;
     memset(h, 0, sizeof(*h));
-    h->id = t->next_id++;
-    h->token = make_token();
+    h->generation = generation;
+    h->next_free = -1;
+    h->id = make_id(t, slot, generation);
+    h->token = make_token(t);
     h->type = type;
     h->fd = fd;
+    h->dir_fd = -1;
     h->seq_ptr = 0;
     h->load_addr = load;
     h->exec_addr = exec;
@@ -56,81 +149,44 @@ int ras_handles_add_ex(ras_handle_table *t, ras_handle_type type, int fd, const
         h->path = (char *)malloc(strlen(path) + 1);
         if (h->path) strcpy(h->path, path);
     }
-    t->count = n;
+    t->count += 1;
     if (out_id) *out_id = h->id;
     if (out_token) *out_token = h->token;
     return 0;
 }
 
 int ras_handles_close(ras_handle_table *t, int id, int token) {
-    if (!t) return -1;
-    for (size_t i = 0; i < t->count; ++i) {
-        if (t->items[i].id == id && t->items[i].token == token) {
-            // Track dead handle
-            int *d = (int *)realloc(t->dead_handles, (t->dead_count + 1) * sizeof(int));
-            if (d) {
-                t->dead_handles = d;
-                t->dead_handles[t->dead_count++] = id;
-            }
-            free(t->items[i].path);
-            t->items[i] = t->items[t->count - 1];
-            t->count -= 1;
-            if (t->count == 0) {
-                free(t->items);
-                t->items = NULL;
-            }
-            return 0;
-        }
-    }
-    return -1;
+    ras_handle *h = slot_for_id(t, id);
+    if (!h || h->token != token) return -1;
+    // Track dead handle
+    track_dead(t, id);
+    release_slot(t, h);
+    return 0;
 }
 
 ras_handle *ras_handles_lookup(ras_handle_table *t, int id, int token) {
-    if (!t) return NULL;
-    for (size_t i = 0; i < t->count; ++i) {
-        if (t->items[i].id == id && t->items[i].token == token) {
-            return &t->items[i];
-        }
-    }
-    return NULL;
+    ras_handle *h = slot_for_id(t, id);
+    if (!h || h->token != token) return NULL;
+    return h;
 }
 
 // Lookup by ID only (no token check)
 int ras_handles_get(ras_handle_table *t, int id, ras_handle **out) {
     if (!t || !out) return -1;
-    for (size_t i = 0; i < t->count; ++i) {
-        if (t->items[i].id == id) {
-            *out = &t->items[i];
-            return 0;
-        }
-    }
-    *out = NULL;
-    return -1;
+    *out = slot_for_id(t, id);
+    return *out ? 0 : -1;
 }
 
 // Close by ID only (no token check)
 int ras_handles_remove(ras_handle_table *t, int id) {
-    if (!t) return -1;
-    for (size_t i = 0; i < t->count; ++i) {
-        if (t->items[i].id == id) {
-            // Track dead handle
-            int *d = (int *)realloc(t->dead_handles, (t->dead_count + 1) * sizeof(int));
-            if (d) {
-                t->dead_handles = d;
-                t->dead_handles[t->dead_count++] = id;
-            }
-            if (t->items[i].fd >= 0) close(t->items[i].fd);
-            free(t->items[i].path);
-            t->items[i] = t->items[t->count - 1];
-            t->count -= 1;
-            if (t->count == 0) {
-                free(t->items);
-                t->items = NULL;
-            }
-            return 0;
-        }
-    }
-    return -1;
+    ras_handle *h = slot_for_id(t, id);
+    if (!h) return -1;
+    // Track dead handle
+    track_dead(t, id);
+    ras_fileio_release(h);
+    if (h->fd >= 0) close(h->fd);
+    release_slot(t, h);
+    return 0;
 }
 
 void ras_handles_clear_dead(ras_handle_table *t) {
@@ -138,6 +194,7 @@ void ras_handles_clear_dead(ras_handle_table *t) {
     free(t->dead_handles);
     t->dead_handles = NULL;
     t->dead_count = 0;
+    t->dead_cap = 0;
 }
 
 const int *ras_handles_get_dead(ras_handle_table *t, size_t *out_count) {
@@ -8,6 +8,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+struct ras_dir_snapshot;
+
 typedef enum {
     RAS_HANDLE_NONE = 0,
     RAS_HANDLE_FILE = 1,
@@ -15,7 +17,7 @@ typedef enum {
 } ras_handle_type;
 
 typedef struct {
-    int id;
+    int id;                // 0 while the slot is free
     int token;
     ras_handle_type type;
     int fd;
@@ -25,18 +27,53 @@ typedef struct {
     uint32_t length;       // File length at open time
     uint32_t attrs;        // RISC OS attributes
     char *path;            // Host path for directory handles
+    struct ras_dir_snapshot *listing; // Sorted entries captured at open (directories)
+    size_t dir_next;       // Listing entry after the last page sent
+    size_t dir_page;       // First entry of the last B-form RREADDIR page
+    uint32_t dir_rid;      // That request's reply ID + 1, 0 = none yet
+    int dir_fd;            // Open directory for directory handles, else -1
+    unsigned char *ra_buf; // Read-ahead buffer (fileio.c), NULL until sequential
+    uint32_t ra_pos;       // File position of ra_buf[0]
+    uint32_t ra_len;       // Valid bytes in ra_buf
+    uint64_t ra_filled_ms; // When ra_buf was filled
+    uint32_t ra_next;      // Position just after the previous read
+    int ra_streak;         // Consecutive reads that continued the previous one
+    unsigned char *wb_buf; // Write-behind buffer (fileio.c), NULL until first write
+    uint32_t wb_cap;       // Write-behind size from the share (0 = write through)
+    uint32_t wb_pos;       // File position of wb_buf[0]
+    uint32_t wb_len;       // Bytes not yet written to the file
+    uint64_t wb_since_ms;  // When the oldest buffered byte arrived
+    int wb_error;          // errno of a failed background flush, reported later
+    int written;           // File data was written through this handle
+    int next_free;         // Free-list link while the slot is unused
+    uint8_t generation;    // Bumped on every reuse of the slot
 } ras_handle;
 
+// Handle ID layout: worker(bits 24-29) | generation(16-23) | slot + 1(0-15).
+// The slot gives O(1) lookup; the generation makes a stale ID for a reused
+// slot fail lookup. Worker N's IDs carry N so RDEADHANDLES broadcasts from
+// one worker never name another worker's handles.
+#define RAS_HANDLE_WORKER_SHIFT 24
+#define RAS_HANDLE_GEN_SHIFT    16
+#define RAS_HANDLE_SLOT_MASK    0xFFFF
+#define RAS_HANDLE_MAX_SLOTS    0xFFFF
+
 typedef struct {
-    ras_handle *items;
-    size_t count;
-    int next_id;
+    ras_handle *slots;     // Slot array, grown geometrically
+    size_t capacity;
+    size_t count;          // Slots in use
+    int free_head;         // First free slot, -1 if none
+    int id_base;           // Worker namespace for handle IDs
     int *dead_handles;     // Recently closed handle IDs for RDEADHANDLES
     size_t dead_count;
+    size_t dead_cap;
+    int write_behind;      // Some handle may hold unflushed write data
+    uint32_t token_seed;   // xorshift state for handle tokens, never 0
 } ras_handle_table;
 
 int ras_handles_init(ras_handle_table *t);
 void ras_handles_free(ras_handle_table *t);
+void ras_handles_set_worker(ras_handle_table *t, int worker);
 int ras_handles_add(ras_handle_table *t, ras_handle_type type, int fd, int *out_id, int *out_token);
 int ras_handles_add_ex(ras_handle_table *t, ras_handle_type type, int fd, const char *path,
                        uint32_t load, uint32_t exec, uint32_t len, uint32_t attrs,
@@ -0,0 +1,222 @@
+// RISC OS Access/ShareFS Server - Host Filesystem Access
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifdef __linux__
+#define _GNU_SOURCE  // statx
+#endif
+
+#include "hostfs.h"
+#include "platform.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    const ras_share_config *share;
+    const char *path;  // Share path as configured
+    size_t len;        // Length without trailing '/'
+    int fd;            // Open share directory
+} share_root;
+
+// Written once before the workers start, read-only afterwards
+static share_root *g_roots = NULL;
+static size_t g_root_count = 0;
+
+int ras_hostfs_init(const ras_config *cfg) {
+    if (!cfg || cfg->share_count == 0) return 0;
+    g_roots = (share_root *)calloc(cfg->share_count, sizeof(share_root));
+    if (!g_roots) return -1;
+
+    for (size_t i = 0; i < cfg->share_count; ++i) {
+        const char *path = cfg->shares[i].path;
+        if (!path) continue;
+#ifdef _WIN32
+        // No directory fds here; share paths are only used to match
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        int fd = -1;
+#else
+        int fd = open(path, O_RDONLY | O_DIRECTORY);
+        if (fd < 0) continue;  // Reported as a missing share by the caller
+#endif
+        size_t len = strlen(path);
+        while (len > 1 && path[len - 1] == '/') len--;
+        g_roots[g_root_count].share = &cfg->shares[i];
+        g_roots[g_root_count].path = path;
+        g_roots[g_root_count].len = len;
+        g_roots[g_root_count].fd = fd;
+        g_root_count++;
+    }
+    return 0;
+}
+
+void ras_hostfs_shutdown(void) {
+    for (size_t i = 0; i < g_root_count; ++i) {
+        if (g_roots[i].fd >= 0) close(g_roots[i].fd);
+    }
+    free(g_roots);
+    g_roots = NULL;
+    g_root_count = 0;
+}
+
+// Innermost share containing host_path
+static const share_root *root_for(const char *host_path) {
+    const share_root *best = NULL;
+    for (size_t i = 0; i < g_root_count; ++i) {
+        const share_root *r = &g_roots[i];
+        if (strncmp(host_path, r->path, r->len) != 0) continue;
+        if (host_path[r->len] != '/' && host_path[r->len] != '\0') continue;
+        if (!best || r->len > best->len) best = r;
+    }
+    return best;
+}
+
+const ras_share_config *ras_hostfs_share(const char *host_path) {
+    const share_root *r = host_path ? root_for(host_path) : NULL;
+    return r ? r->share : NULL;
+}
+
+#ifdef _WIN32
+int ras_hostfs_stat(const char *host_path, struct stat *st) {
+    return stat(host_path, st);
+}
+
+int ras_hostfs_open(const char *host_path, int flags, mode_t mode) {
+    return open(host_path, flags | O_BINARY, mode);
+}
+
+int ras_hostfs_mkpath(const char *host_path, mode_t mode) {
+    (void)mode;
+    char tmp[512];
+    size_t len = strlen(host_path);
+    if (len == 0 || len >= sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(tmp, host_path, len + 1);
+    while (len > 1 && tmp[len - 1] == '/') tmp[--len] = '\0';
+
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (ras_mkdir(tmp) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    return ras_mkdir(tmp);
+}
+
+#else
+// Directory fd to resolve host_path from and the path relative to it.
+// Paths outside every share fall back to the full path.
+static int path_at(const char *host_path, const char **rel) {
+    const share_root *best = root_for(host_path);
+    if (!best) {
+        *rel = host_path;
+        return AT_FDCWD;
+    }
+    const char *p = host_path + best->len;
+    while (*p == '/') p++;
+    *rel = *p ? p : ".";
+    return best->fd;
+}
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+#define RAS_HOSTFS_STATX_MASK (STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME)
+
+// Cleared if the kernel predates statx; racing workers agree on the value
+static volatile int g_have_statx = 1;
+#endif
+
+int ras_hostfs_statat(int dir_fd, const char *name, struct stat *st) {
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    if (g_have_statx) {
+        struct statx stx;
+        if (statx(dir_fd, name, 0, RAS_HOSTFS_STATX_MASK, &stx) == 0) {
+            memset(st, 0, sizeof(*st));
+            st->st_mode = (mode_t)stx.stx_mode;
+            st->st_size = (off_t)stx.stx_size;
+            st->st_mtim.tv_sec = (time_t)stx.stx_mtime.tv_sec;
+            st->st_mtim.tv_nsec = (long)stx.stx_mtime.tv_nsec;
+            return 0;
+        }
+        if (errno != ENOSYS) return -1;
+        g_have_statx = 0;
+    }
+#endif
+    return fstatat(dir_fd, name, st, 0);
+}
+
+int ras_hostfs_stat(const char *host_path, struct stat *st) {
+    const char *rel;
+    int dfd = path_at(host_path, &rel);
+    return ras_hostfs_statat(dfd, rel, st);
+}
+
+int ras_hostfs_open(const char *host_path, int flags, mode_t mode) {
+    const char *rel;
+    int dfd = path_at(host_path, &rel);
+    return openat(dfd, rel, flags, mode);
+}
+
+int ras_hostfs_open_dir(const char *host_path) {
+    return ras_hostfs_open(host_path, O_RDONLY | O_DIRECTORY, 0);
+}
+
+// Like mkdir -p, but each component is created and entered relative to
+// its parent's fd, so no prefix of the path is walked twice
+int ras_hostfs_mkpath(const char *host_path, mode_t mode) {
+    const char *rel;
+    int base = path_at(host_path, &rel);
+
+    char tmp[512];
+    size_t len = strlen(rel);
+    if (len >= sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(tmp, rel, len + 1);
+    while (len > 1 && tmp[len - 1] == '/') tmp[--len] = '\0';
+
+    char *p = tmp;
+    int dfd = base;
+    if (*p == '/') {
+        dfd = open("/", O_RDONLY | O_DIRECTORY);
+        if (dfd < 0) return -1;
+        while (*p == '/') p++;
+    }
+
+    int rc = 0;
+    for (;;) {
+        char *slash = strchr(p, '/');
+        if (!slash) {
+            rc = mkdirat(dfd, p, mode);
+            break;
+        }
+        *slash = '\0';
+        int next = -1;
+        if (mkdirat(dfd, p, mode) == 0 || errno == EEXIST) {
+            next = openat(dfd, p, O_RDONLY | O_DIRECTORY);
+        }
+        if (next < 0) {
+            rc = -1;
+            break;
+        }
+        if (dfd != base) close(dfd);
+        dfd = next;
+        p = slash + 1;
+        while (*p == '/') p++;
+    }
+
+    if (dfd != base) {
+        int saved = errno;
+        close(dfd);
+        errno = saved;
+    }
+    return rc;
+}
+
+#endif
@@ -0,0 +1,38 @@
+// RISC OS Access/ShareFS Server - Host Filesystem Access
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_HOSTFS_H
+#define RAS_HOSTFS_H
+
+#include "config.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Open the root directory of every share. Host paths inside a share are
+// then looked up from its open directory rather than from '/', so the
+// kernel only walks the part of the path below the share.
+int ras_hostfs_init(const ras_config *cfg);
+void ras_hostfs_shutdown(void);
+
+// Share whose directory contains a host path, NULL if none
+const ras_share_config *ras_hostfs_share(const char *host_path);
+
+// stat(), open() and mkdir -p for a host path built by resolve_path().
+// Windows has no directory fds, so there these take the full path.
+int ras_hostfs_stat(const char *host_path, struct stat *st);
+int ras_hostfs_open(const char *host_path, int flags, mode_t mode);
+int ras_hostfs_mkpath(const char *host_path, mode_t mode);
+
+#ifndef _WIN32
+// fstatat() asking only for what a FileDesc needs: st_mode, st_size and
+// st_mtime are filled in, other fields are zero. Uses statx with a
+// reduced mask on Linux, so network filesystems can skip the rest.
+int ras_hostfs_statat(int dir_fd, const char *name, struct stat *st);
+
+// Open a directory for reading its entries with ras_hostfs_statat(dirfd(d), ...)
+int ras_hostfs_open_dir(const char *host_path);
+#endif
+
+#endif
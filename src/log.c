@@ -37,7 +37,14 @@ void ras_log(ras_log_level level, const char *fmt, ...) {
 
     va_list ap;
     va_start(ap, fmt);
+    // Keep lines from different worker threads whole
+#ifndef _WIN32
+    flockfile(out);
+#endif
     vfprintf(out, fmt, ap);
     fputc('\n', out);
+#ifndef _WIN32
+    funlockfile(out);
+#endif
     va_end(ap);
 }
@@ -45,7 +45,7 @@ int main(int argc, char **argv) {
     if (cfg.server.bind_ip) {
         ras_log(RAS_LOG_INFO, "Binding to specific address: %s", cfg.server.bind_ip);
     }
-    if (ras_net_open(&net, cfg.server.bind_ip) != 0) {
+    if (ras_net_open(&net, cfg.server.bind_ip, cfg.server.workers > 1) != 0) {
         fprintf(stderr, "Failed to open network sockets\n");
         ras_config_unload(&cfg);
         ras_platform_shutdown();
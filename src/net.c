@@ -2,9 +2,14 @@
 // Author: Andrew Timmins
 // License: GPL-3.0-only
 
+#ifdef __linux__
+#define _GNU_SOURCE  // recvmmsg/sendmmsg
+#endif
+
 #include "net.h"
 #include "log.h"
 
+#include <errno.h>
 #include <string.h>
 
 #ifdef _WIN32
@@ -13,7 +18,25 @@
 #include <arpa/inet.h>
 #endif
 
-static ras_socket open_udp(unsigned short port, const char *bind_addr) {
+#ifdef __linux__
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+// Path MTU lookups are cached briefly per worker thread
+#define MTU_CACHE_SIZE 16
+#define MTU_CACHE_TTL_MS 60000
+
+typedef struct {
+    char addr[64];
+    int mtu;
+    uint64_t expires_ms;
+} mtu_cache_entry;
+
+static RAS_THREAD_LOCAL mtu_cache_entry mtu_cache[MTU_CACHE_SIZE];
+#endif
+
+static ras_socket open_udp(unsigned short port, const char *bind_addr, int reuseport) {
     ras_socket s = (ras_socket)socket(AF_INET, SOCK_DGRAM, 0);
     if (s == RAS_INVALID_SOCKET) {
         return RAS_INVALID_SOCKET;
@@ -32,7 +55,14 @@ static ras_socket open_udp(unsigned short port, const char *bind_addr) {
     setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
 #endif
 
-    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    int reuse_ok = !reuseport;
+#ifdef SO_REUSEPORT
+    if (reuseport && setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == 0) {
+        reuse_ok = 1;
+    }
+#endif
+
+    if (!reuse_ok || bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
 #ifdef _WIN32
         closesocket(s);
 #else
@@ -44,14 +74,14 @@ static ras_socket open_udp(unsigned short port, const char *bind_addr) {
     return s;
 }
 
-int ras_net_open(ras_net *net, const char *bind_addr) {
+int ras_net_open(ras_net *net, const char *bind_addr, int reuseport) {
     if (!net) return -1;
     memset(net, 0, sizeof(*net));
 
-    net->broadcast = open_udp(RAS_PORT_BROADCAST, bind_addr);
-    net->freeway   = open_udp(RAS_PORT_BROADCAST, bind_addr);  // Listen on same port
-    net->auth      = open_udp(RAS_PORT_AUTH, bind_addr);
-    net->rpc       = open_udp(RAS_PORT_RPC, bind_addr);
+    net->broadcast = open_udp(RAS_PORT_BROADCAST, bind_addr, 0);
+    net->freeway   = open_udp(RAS_PORT_BROADCAST, bind_addr, 0);  // Listen on same port
+    net->auth      = open_udp(RAS_PORT_AUTH, bind_addr, reuseport);
+    net->rpc       = open_udp(RAS_PORT_RPC, bind_addr, reuseport);
 
     if (net->broadcast == RAS_INVALID_SOCKET || net->auth == RAS_INVALID_SOCKET || net->rpc == RAS_INVALID_SOCKET) {
         ras_net_close(net);
@@ -72,6 +102,55 @@ int ras_net_open(ras_net *net, const char *bind_addr) {
     return 0;
 }
 
+int ras_net_open_worker(ras_net *net, const char *bind_addr) {
+    if (!net) return -1;
+    memset(net, 0, sizeof(*net));
+
+    // Workers only serve RPC and Access+; broadcasts stay with the primary
+    net->broadcast = RAS_INVALID_SOCKET;
+    net->freeway   = RAS_INVALID_SOCKET;
+    net->auth      = open_udp(RAS_PORT_AUTH, bind_addr, 1);
+    net->rpc       = open_udp(RAS_PORT_RPC, bind_addr, 1);
+
+    if (net->auth == RAS_INVALID_SOCKET || net->rpc == RAS_INVALID_SOCKET) {
+        ras_net_close(net);
+        return -1;
+    }
+    return 0;
+}
+
+#ifdef __linux__
+// Classic BPF run by the kernel for each datagram arriving on a reuseport
+// group. It returns the index of the socket (= worker) to deliver to, derived
+// from the client's IPv4 source address so a client always hits one worker.
+static int attach_steering(ras_socket s, unsigned int workers) {
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)SKF_NET_OFF + 12),  // IPv4 saddr
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 0x9E3779B1u),           // Fibonacci hash
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),                      // Fold high bits down
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, workers),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog;
+    prog.len = (unsigned short)(sizeof(code) / sizeof(code[0]));
+    prog.filter = code;
+    return setsockopt(s, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+#endif
+
+int ras_net_attach_steering(ras_net *net, unsigned int workers) {
+    if (!net || workers == 0) return -1;
+#ifdef __linux__
+    if (attach_steering(net->rpc, workers) != 0) return -1;
+    if (attach_steering(net->auth, workers) != 0) return -1;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
 void ras_net_close(ras_net *net) {
     if (!net) return;
 #ifdef _WIN32
@@ -117,3 +196,200 @@ ssize_t ras_net_recvfrom(ras_socket s, void *buf, size_t len, char *addr, size_t
     }
     return n;
 }
+
+int ras_net_recv_batch(ras_socket s, ras_net_msg *msgs, size_t max) {
+    if (!msgs || max == 0) return -1;
+    if (max > RAS_NET_MAX_BATCH) max = RAS_NET_MAX_BATCH;
+
+#ifdef __linux__
+    struct mmsghdr hdrs[RAS_NET_MAX_BATCH];
+    struct iovec iovs[RAS_NET_MAX_BATCH];
+    struct sockaddr_in from[RAS_NET_MAX_BATCH];
+    memset(hdrs, 0, max * sizeof(hdrs[0]));
+    for (size_t i = 0; i < max; ++i) {
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = sizeof(msgs[i].buf);
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        hdrs[i].msg_hdr.msg_name = &from[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+
+    int n = recvmmsg(s, hdrs, (unsigned int)max, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    for (int i = 0; i < n; ++i) {
+        msgs[i].len = hdrs[i].msg_len;
+        msgs[i].port = ntohs(from[i].sin_port);
+        if (!inet_ntop(AF_INET, &from[i].sin_addr, msgs[i].addr, sizeof(msgs[i].addr))) {
+            msgs[i].addr[0] = '\0';
+        }
+    }
+    return n;
+#else
+    ssize_t n = ras_net_recvfrom(s, msgs[0].buf, sizeof(msgs[0].buf), msgs[0].addr, sizeof(msgs[0].addr), &msgs[0].port);
+    if (n < 0) return -1;
+    msgs[0].len = (size_t)n;
+    return 1;
+#endif
+}
+
+ssize_t ras_net_reply(ras_net *net, const void *buf, size_t len, const char *addr, unsigned short port) {
+    if (!net || !buf) return -1;
+    ras_net_capture *c = net->capture;
+    if (c && !c->overflow) {
+        if (len > 0xFFFF || c->used + 2 + len > c->cap) {
+            c->overflow = 1;
+        } else {
+            c->data[c->used] = (unsigned char)(len & 0xFF);
+            c->data[c->used + 1] = (unsigned char)(len >> 8);
+            memcpy(c->data + c->used + 2, buf, len);
+            c->used += 2 + len;
+        }
+    }
+
+    ras_net_txq *q = net->txq;
+    if (!q || len > sizeof(q->data)) {
+        return ras_net_sendto(net->rpc, buf, len, addr, port);
+    }
+
+    if (q->count == RAS_NET_MAX_BATCH || q->used + len > sizeof(q->data)) {
+        ras_net_flush(net);
+    }
+
+    ras_net_txq_entry *e = &q->entries[q->count++];
+    e->off = q->used;
+    e->len = len;
+    e->addr = addr ? inet_addr(addr) : htonl(INADDR_BROADCAST);
+    e->port = htons(port);
+    memcpy(q->data + q->used, buf, len);
+    q->used += len;
+    return (ssize_t)len;
+}
+
+void ras_net_begin_batch(ras_net *net, ras_net_txq *q) {
+    if (!net) return;
+    if (q) {
+        q->count = 0;
+        q->used = 0;
+    }
+    net->txq = q;
+}
+
+int ras_net_flush(ras_net *net) {
+    if (!net || !net->txq) return 0;
+    ras_net_txq *q = net->txq;
+    int rc = 0;
+
+#ifdef __linux__
+    struct mmsghdr hdrs[RAS_NET_MAX_BATCH];
+    struct iovec iovs[RAS_NET_MAX_BATCH];
+    struct sockaddr_in to[RAS_NET_MAX_BATCH];
+    memset(hdrs, 0, q->count * sizeof(hdrs[0]));
+    for (size_t i = 0; i < q->count; ++i) {
+        memset(&to[i], 0, sizeof(to[i]));
+        to[i].sin_family = AF_INET;
+        to[i].sin_port = q->entries[i].port;
+        to[i].sin_addr.s_addr = q->entries[i].addr;
+        iovs[i].iov_base = q->data + q->entries[i].off;
+        iovs[i].iov_len = q->entries[i].len;
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        hdrs[i].msg_hdr.msg_name = &to[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(to[i]);
+    }
+
+    size_t sent = 0;
+    while (sent < q->count) {
+        int n = sendmmsg(net->rpc, hdrs + sent, (unsigned int)(q->count - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Skip the datagram that failed so one bad peer cannot stall the rest
+            ras_log(RAS_LOG_DEBUG, "sendmmsg failed: errno=%d", errno);
+            rc = -1;
+            sent++;
+            continue;
+        }
+        sent += (size_t)n;
+    }
+#else
+    for (size_t i = 0; i < q->count; ++i) {
+        struct sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_port = q->entries[i].port;
+        to.sin_addr.s_addr = q->entries[i].addr;
+        if (sendto(net->rpc, (const char *)(q->data + q->entries[i].off), (int)q->entries[i].len, 0,
+                   (struct sockaddr *)&to, sizeof(to)) < 0) {
+            rc = -1;
+        }
+    }
+#endif
+
+    q->count = 0;
+    q->used = 0;
+    return rc;
+}
+
+void ras_net_end_batch(ras_net *net) {
+    if (!net) return;
+    ras_net_flush(net);
+    net->txq = NULL;
+}
+
+void ras_net_begin_capture(ras_net *net, ras_net_capture *c) {
+    if (!net) return;
+    if (c) {
+        c->used = 0;
+        c->overflow = 0;
+    }
+    net->capture = c;
+}
+
+void ras_net_end_capture(ras_net *net) {
+    if (net) net->capture = NULL;
+}
+
+#ifdef __linux__
+// Ask the kernel for the route MTU via a connected probe socket; nothing
+// is sent, connect() on UDP only resolves the route
+static int probe_path_mtu(const char *addr) {
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(RAS_PORT_RPC);
+    if (inet_pton(AF_INET, addr, &to.sin_addr) != 1) return 0;
+
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) return 0;
+    int mtu = 0;
+    socklen_t len = sizeof(mtu);
+    if (connect(s, (struct sockaddr *)&to, sizeof(to)) != 0 ||
+        getsockopt(s, IPPROTO_IP, IP_MTU, &mtu, &len) != 0) {
+        mtu = 0;
+    }
+    close(s);
+    return mtu;
+}
+#endif
+
+int ras_net_path_mtu(const char *addr) {
+    if (!addr || !addr[0]) return 0;
+#ifdef __linux__
+    uint64_t now = ras_monotonic_ms();
+    size_t h = 0;
+    for (const char *p = addr; *p; ++p) h = h * 31u + (unsigned char)*p;
+    mtu_cache_entry *e = &mtu_cache[h % MTU_CACHE_SIZE];
+    if (e->expires_ms > now && strcmp(e->addr, addr) == 0) return e->mtu;
+
+    int mtu = probe_path_mtu(addr);
+    strncpy(e->addr, addr, sizeof(e->addr) - 1);
+    e->addr[sizeof(e->addr) - 1] = '\0';
+    e->mtu = mtu;
+    e->expires_ms = now + MTU_CACHE_TTL_MS;
+    return mtu;
+#else
+    return 0;
+#endif
+}
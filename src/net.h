@@ -8,26 +8,88 @@
 #include "platform.h"
 
 #include <stddef.h>
-
-#ifdef _WIN32
-#include <BaseTsd.h>
-typedef SSIZE_T ssize_t;
-#endif
+#include <stdint.h>
 
 #define RAS_PORT_BROADCAST 32770
 #define RAS_PORT_AUTH      32771
 #define RAS_PORT_RPC       49171
 
+#define RAS_NET_MAX_BATCH  64     // Upper bound on datagrams per receive batch
+#define RAS_NET_RX_MAX     8208   // Largest RPC datagram we accept (8 KB d packet + header)
+#define RAS_NET_TXQ_BYTES  65536  // Reply bytes buffered before a forced flush
+
+// One received datagram
+typedef struct {
+    unsigned char buf[RAS_NET_RX_MAX];
+    size_t len;
+    char addr[64];
+    unsigned short port;
+} ras_net_msg;
+
+typedef struct {
+    size_t off;            // Offset of the datagram in data[]
+    size_t len;
+    uint32_t addr;         // Destination, network byte order
+    unsigned short port;
+} ras_net_txq_entry;
+
+// RPC replies queued while a receive batch is dispatched
+typedef struct {
+    ras_net_txq_entry entries[RAS_NET_MAX_BATCH];
+    size_t count;
+    unsigned char data[RAS_NET_TXQ_BYTES];
+    size_t used;
+} ras_net_txq;
+
+// Copy of the replies sent for one request, for the reply cache. Each
+// datagram is stored as a 16-bit little-endian length and its bytes.
+typedef struct {
+    unsigned char *data;
+    size_t cap;
+    size_t used;
+    int overflow;          // A reply did not fit, so the copy is incomplete
+} ras_net_capture;
+
 typedef struct {
     ras_socket broadcast;
     ras_socket freeway;
     ras_socket auth;
     ras_socket rpc;
+    ras_net_txq *txq;      // Non-NULL while RPC replies are being batched
+    ras_net_capture *capture; // Non-NULL while RPC replies are being recorded
 } ras_net;
 
-int ras_net_open(ras_net *net, const char *bind_addr);
+// Open the server sockets. With reuseport set, the RPC and Access+ sockets
+// join SO_REUSEPORT groups so that worker sockets can bind alongside them.
+int ras_net_open(ras_net *net, const char *bind_addr, int reuseport);
+
+// Open an additional RPC/Access+ socket pair for a worker thread
+int ras_net_open_worker(ras_net *net, const char *bind_addr);
+
+// Steer each client IP to a fixed worker: socket i of each reuseport group
+// (in bind order) belongs to worker i. Linux only; returns -1 elsewhere.
+int ras_net_attach_steering(ras_net *net, unsigned int workers);
 void ras_net_close(ras_net *net);
 ssize_t ras_net_sendto(ras_socket s, const void *buf, size_t len, const char *addr, unsigned short port);
 ssize_t ras_net_recvfrom(ras_socket s, void *buf, size_t len, char *addr, size_t addr_len, unsigned short *port);
 
+// Receive up to max datagrams without blocking (recvmmsg on Linux).
+// Returns the number received, 0 if none were pending, or -1 on error.
+int ras_net_recv_batch(ras_socket s, ras_net_msg *msgs, size_t max);
+
+// Send an RPC reply to a client, or queue it if a batch is in progress
+ssize_t ras_net_reply(ras_net *net, const void *buf, size_t len, const char *addr, unsigned short port);
+
+// Path MTU towards a client (cached per thread), or 0 if unknown
+int ras_net_path_mtu(const char *addr);
+
+// Start queueing RPC replies into q; ras_net_flush() sends them (sendmmsg on Linux)
+void ras_net_begin_batch(ras_net *net, ras_net_txq *q);
+int ras_net_flush(ras_net *net);
+void ras_net_end_batch(ras_net *net);
+
+// Record a copy of every RPC reply into c until ras_net_end_capture()
+void ras_net_begin_capture(ras_net *net, ras_net_capture *c);
+void ras_net_end_capture(ras_net *net);
+
 #endif
@@ -7,6 +7,15 @@
 #include "riscos.h"
 #include "platform.h"
 #include "accessplus.h"
+#include "transfer.h"
+#include "fileio.h"
+#include "replycache.h"
+#include "dircache.h"
+#include "hostfs.h"
+#include "statpool.h"
+#include "pathcache.h"
+#include "attrcache.h"
+#include "xattr.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -15,101 +24,18 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <utime.h>
 
-// Maximum pending write transfers
-#define MAX_PENDING_WRITES 32
-#define WRITE_CHUNK_SIZE 4096
-
-// Pending write transfer state
-typedef struct {
-    int active;
-    int handle_id;
-    uint32_t start_pos;       // Original start position from client
-    uint32_t current_pos;     // Current position in file
-    uint32_t end_pos;         // End position (start + amount)
-    unsigned char rid[3];     // Reply ID to use
-    char addr[64];            // Client address
-    unsigned short port;      // Client port
-} pending_write_t;
-
-static pending_write_t pending_writes[MAX_PENDING_WRITES];
-
-static pending_write_t *find_pending_write(const unsigned char *rid) {
-    for (int i = 0; i < MAX_PENDING_WRITES; i++) {
-        if (pending_writes[i].active && 
-            pending_writes[i].rid[0] == rid[0] &&
-            pending_writes[i].rid[1] == rid[1] &&
-            pending_writes[i].rid[2] == rid[2]) {
-            return &pending_writes[i];
-        }
-    }
-    return NULL;
-}
-
-static pending_write_t *alloc_pending_write(void) {
-    for (int i = 0; i < MAX_PENDING_WRITES; i++) {
-        if (!pending_writes[i].active) {
-            pending_writes[i].active = 1;
-            return &pending_writes[i];
-        }
-    }
-    return NULL;
-}
-
-static void free_pending_write(pending_write_t *pw) {
-    if (pw) pw->active = 0;
-}
-
-// Pending read transfer state
-#define MAX_PENDING_READS 32
-#define READ_CHUNK_SIZE 1024
+#define READ_CHUNK_MIN 1024       // Classic D packet payload, fits any Ethernet frame
+#define WRITE_REORDER_THRESHOLD 3 // d packets past a hole before it is re-requested early
+#define WRITE_MAX_HOLES 8         // w packets sent per retransmit
 
 // States for RREAD ping-pong protocol
 #define RAS_READ_STATE_WAIT_DATA_ACK   0
 #define RAS_READ_STATE_WAIT_STATUS_ACK 1
 
-typedef struct {
-    int active;
-    int state;                // Current state
-    int handle_id;
-    uint32_t start_pos;       // Original start position
-    uint32_t current_pos;     // Current position (being sent)
-    uint32_t end_pos;         // End position
-    unsigned char rid[3];
-    char addr[64];
-    unsigned short port;
-} pending_read_t;
-
-static pending_read_t pending_reads[MAX_PENDING_READS];
-
-static pending_read_t *find_pending_read(const unsigned char *rid) {
-    for (int i = 0; i < MAX_PENDING_READS; i++) {
-        if (pending_reads[i].active && 
-            pending_reads[i].rid[0] == rid[0] &&
-            pending_reads[i].rid[1] == rid[1] &&
-            pending_reads[i].rid[2] == rid[2]) {
-            return &pending_reads[i];
-        }
-    }
-    return NULL;
-}
-
-static pending_read_t *alloc_pending_read(void) {
-    for (int i = 0; i < MAX_PENDING_READS; i++) {
-        if (!pending_reads[i].active) {
-            pending_reads[i].active = 1;
-            return &pending_reads[i];
-        }
-    }
-    return NULL;
-}
-
-static void free_pending_read(pending_read_t *pr) {
-    if (pr) pr->active = 0;
-}
-
 static unsigned int read_u32(const unsigned char *p) {
     return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
 }
@@ -121,27 +47,13 @@ static void write_u32(unsigned char *p, unsigned int v) {
     p[3] = (unsigned char)((v >> 24) & 0xFF);
 }
 
-// Create parent directories for a path (like mkdir -p)
-static int mkpath(const char *path, mode_t mode) {
-    char tmp[512];
-    size_t len = strlen(path);
-    if (len >= sizeof(tmp)) return -1;
-    strcpy(tmp, path);
-    
-    // Remove trailing slash
-    if (tmp[len - 1] == '/') tmp[--len] = '\0';
-    
-    // Create each component
-    for (char *p = tmp + 1; *p; p++) {
-        if (*p == '/') {
-            *p = '\0';
-            if (mkdir(tmp, mode) != 0 && errno != EEXIST) {
-                return -1;
-            }
-            *p = '/';
-        }
-    }
-    return mkdir(tmp, mode);
+// Forget everything cached about a host object the server has just
+// created, changed or removed: its directory's listing, its details and,
+// when the request named it, the RISC OS path it was found at
+static void object_changed(const char *host_path, const char *ro_path) {
+    ras_dircache_invalidate_parent(host_path);
+    ras_attrcache_invalidate(host_path);
+    if (ro_path) ras_pathcache_forget(ro_path);
 }
 
 // Send 'w' packet to request data from client
@@ -156,7 +68,92 @@ static void send_w_pkt(ras_net *net, const unsigned char *rid, uint32_t rel_pos,
     write_u32(pkt + 8, 0);
     write_u32(pkt + 12, rel_end);
     ras_log(RAS_LOG_DEBUG, "Sending w-pkt: rel_pos=%u rel_end=%u", rel_pos, rel_end);
-    ras_net_sendto(net->rpc, pkt, sizeof(pkt), addr, port);
+    ras_net_reply(net, pkt, sizeof(pkt), addr, port);
+}
+
+// Ask the client for the next window of an RWRITE: up to write_window
+// chunks in a single w packet, answered by one or more d packets.
+// The window comes from the config, which keeps it in 1..RAS_MAX_WRITE_WINDOW.
+static void request_write_window(ras_net *net, ras_transfer *pw) {
+    uint32_t span = pw->end_pos - pw->current_pos;
+    uint64_t window = (uint64_t)pw->chunk * (uint64_t)pw->window;
+    if (span > window) span = (uint32_t)window;
+    pw->last_pos = pw->current_pos;
+    pw->last_len = span;
+    send_w_pkt(net, pw->rid, pw->current_pos - pw->start_pos, pw->current_pos + span - pw->start_pos,
+               pw->addr, pw->port);
+}
+
+// Write an in-order d packet plus the held segments that continue it,
+// advancing current_pos. Returns 0, or -1 with errno set.
+static int write_in_order(ras_handle_table *handles, ras_handle *h, ras_transfer *pw,
+                          const unsigned char *data, size_t data_len) {
+    for (;;) {
+        ras_iovec iov[RAS_MAX_IOV];
+        int count = 0;
+        size_t total = 0;
+        uint32_t end = pw->current_pos;
+        if (data) {
+            iov[count].base = data;
+            iov[count].len = data_len;
+            count++;
+            end += (uint32_t)data_len;
+        }
+
+        // Gather held segments that start at or before the running end
+        size_t used = 0;
+        while (count < RAS_MAX_IOV && used < pw->seg_count && pw->segs[used].pos <= end) {
+            const ras_transfer_seg *seg = &pw->segs[used];
+            if (seg->pos + seg->len > end) {
+                uint32_t skip = end - seg->pos;
+                iov[count].base = seg->data + skip;
+                iov[count].len = seg->len - skip;
+                count++;
+                end = seg->pos + seg->len;
+            }
+            used++;
+        }
+        for (int i = 0; i < count; ++i) total += iov[i].len;
+        if (total == 0) {
+            while (used-- > 0) ras_transfers_pop_seg(pw);
+            return 0;
+        }
+
+        if (ras_fileio_write(handles, h, iov, count, pw->current_pos) != 0) return -1;
+        pw->current_pos = end;
+        while (used-- > 0) ras_transfers_pop_seg(pw);
+
+        // More held data may follow if the iovec limit was reached
+        if (!ras_transfers_ready_seg(pw)) return 0;
+        data = NULL;
+        data_len = 0;
+    }
+}
+
+// Re-request only the gaps between held out-of-order data in the current
+// window, one w packet per gap, at most max_holes of them
+static void request_write_holes(ras_net *net, const ras_transfer *pw, int max_holes) {
+    uint32_t window_end = pw->last_pos + pw->last_len;
+    uint32_t cursor = pw->current_pos;
+    int sent = 0;
+    for (size_t i = 0; i <= pw->seg_count && sent < max_holes && cursor < window_end; ++i) {
+        uint32_t hole_end = i < pw->seg_count ? pw->segs[i].pos : window_end;
+        if (hole_end > window_end) hole_end = window_end;
+        if (hole_end > cursor) {
+            send_w_pkt(net, pw->rid, cursor - pw->start_pos, hole_end - pw->start_pos, pw->addr, pw->port);
+            sent++;
+        }
+        if (i < pw->seg_count && pw->segs[i].pos + pw->segs[i].len > cursor) {
+            cursor = pw->segs[i].pos + pw->segs[i].len;
+        }
+    }
+}
+
+// Share named by the first component of a RISC OS path
+static const ras_share_config *share_for_path(const ras_config *cfg, const char *ro_path) {
+    const char *dot = strchr(ro_path, '.');
+    size_t share_len = dot ? (size_t)(dot - ro_path) : strlen(ro_path);
+    return ras_config_find_share(cfg, ro_path, share_len);
 }
 
 static int resolve_path(const ras_config *cfg, const char *ro_path, char *out, size_t out_sz) {
@@ -165,101 +162,57 @@ static int resolve_path(const ras_config *cfg, const char *ro_path, char *out, s
     // RISC OS uses '.' as path separator - convert to Unix '/'
     // Find the share name (first component before '.')
     const char *dot = strchr(ro_path, '.');
-    size_t share_len = dot ? (size_t)(dot - ro_path) : strlen(ro_path);
     
-    ras_log(RAS_LOG_DEBUG, "resolve_path: ro_path='%s' share_len=%zu", ro_path, share_len);
+    ras_log(RAS_LOG_DEBUG, "resolve_path: ro_path='%s'", ro_path);
     
-    for (size_t i = 0; i < cfg->share_count; ++i) {
-        const char *name = cfg->shares[i].name;
-        if (name && strlen(name) == share_len && strncasecmp(name, ro_path, share_len) == 0) {
-            // Build the host path, converting '.' to '/'
-            const char *rest = dot ? dot + 1 : "";
-            int n = snprintf(out, out_sz, "%s", cfg->shares[i].path);
-            if (n < 0 || (size_t)n >= out_sz) return -1;
-            
-            // Append rest of path, converting '.' to '/'
-            size_t offset = (size_t)n;
-            while (*rest && offset < out_sz - 1) {
-                out[offset++] = '/';
-                while (*rest && *rest != '.' && offset < out_sz - 1) {
-                    out[offset++] = *rest++;
-                }
-                if (*rest == '.') rest++;
-            }
-            out[offset] = '\0';
-            
-            ras_log(RAS_LOG_DEBUG, "resolve_path: resolved to '%s'", out);
-            
-            // Safety check on final path - skip the leading '/' separator
-            const char *rel = out + strlen(cfg->shares[i].path);
-            if (*rel == '/') rel++;  // Skip separator
-            if (!ras_path_is_safe(rel)) {
-                ras_log(RAS_LOG_DEBUG, "resolve_path: safety check failed on '%s'", rel);
-                return -1;
-            }
-            return 0;
-        }
+    const ras_share_config *share = share_for_path(cfg, ro_path);
+    if (!share) {
+        ras_log(RAS_LOG_DEBUG, "resolve_path: no matching share found");
+        return -1;
     }
-    ras_log(RAS_LOG_DEBUG, "resolve_path: no matching share found");
-    return -1;
-}
 
-// Try to find a file, checking for ,xxx filetype suffix variants
-// If the exact path doesn't exist, scan directory for matching base name with suffix
-static int find_file_with_suffix(const char *base_path, char *out, size_t out_sz) {
-    struct stat st;
+    // Build the host path, converting '.' to '/'
+    const char *rest = dot ? dot + 1 : "";
+    if (share->path_len >= out_sz) return -1;
+    memcpy(out, share->path, share->path_len + 1);
     
-    // First, try exact path
-    if (stat(base_path, &st) == 0) {
-        strncpy(out, base_path, out_sz - 1);
-        out[out_sz - 1] = '\0';
-        return 0;
+    // Append rest of path, converting '.' to '/'
+    size_t offset = share->path_len;
+    while (*rest && offset < out_sz - 1) {
+        out[offset++] = '/';
+        while (*rest && *rest != '.' && offset < out_sz - 1) {
+            out[offset++] = *rest++;
+        }
+        if (*rest == '.') rest++;
     }
+    out[offset] = '\0';
     
-    // Extract directory and filename
-    const char *last_slash = strrchr(base_path, '/');
-    if (!last_slash) {
-        return -1;  // No directory component
-    }
+    ras_log(RAS_LOG_DEBUG, "resolve_path: resolved to '%s'", out);
     
-    size_t dir_len = (size_t)(last_slash - base_path);
-    char dir_path[512];
-    if (dir_len >= sizeof(dir_path)) return -1;
-    memcpy(dir_path, base_path, dir_len);
-    dir_path[dir_len] = '\0';
-    
-    const char *filename = last_slash + 1;
-    size_t filename_len = strlen(filename);
-    
-    // Scan directory for file with matching base name + ,xxx suffix
-    DIR *d = opendir(dir_path);
-    if (!d) return -1;
-    
-    struct dirent *ent;
-    while ((ent = readdir(d)) != NULL) {
-        size_t ent_len = strlen(ent->d_name);
-        
-        // Check for base name + ,xxx pattern
-        if (ent_len == filename_len + 4 &&
-            strncasecmp(ent->d_name, filename, filename_len) == 0 &&
-            ent->d_name[filename_len] == ',' &&
-            ras_filetype_from_suffix(ent->d_name) >= 0) {
-            
-            snprintf(out, out_sz, "%s/%s", dir_path, ent->d_name);
-            closedir(d);
-            return 0;
-        }
+    // Safety check on final path - skip the leading '/' separator
+    const char *rel = out + share->path_len;
+    if (*rel == '/') rel++;  // Skip separator
+    if (!ras_path_is_safe(rel)) {
+        ras_log(RAS_LOG_DEBUG, "resolve_path: safety check failed on '%s'", rel);
+        return -1;
+    }
+    return 0;
+}
+
+// Give a handle opened for writing its share's write-behind buffer size
+static void set_write_buffer(const ras_config *cfg, ras_handle_table *handles, int hid, const char *ro_path) {
+    ras_handle *h = NULL;
+    const ras_share_config *share = share_for_path(cfg, ro_path);
+    if (share && ras_handles_get(handles, hid, &h) == 0 && h) {
+        h->wb_cap = share->write_buffer > 0 ? (uint32_t)share->write_buffer : 0;
     }
-    
-    closedir(d);
-    return -1;
 }
 
 static void send_err_pkt(ras_net *net, const unsigned char *rid, int code, const char *addr, unsigned short port) {
     unsigned char pkt[8] = { 'E', rid[0], rid[1], rid[2], 0, 0, 0, 0 };
     pkt[4] = (unsigned char)(code & 0xFF);
     ras_log(RAS_LOG_PROTOCOL, "Sending E-pkt: error=%d", code);
-    ras_net_sendto(net->rpc, pkt, sizeof(pkt), addr, port);
+    ras_net_reply(net, pkt, sizeof(pkt), addr, port);
 }
 
 static void send_r_pkt(ras_net *net, const unsigned char *rid, const void *data, size_t dlen, const char *addr, unsigned short port) {
@@ -269,7 +222,7 @@ static void send_r_pkt(ras_net *net, const unsigned char *rid, const void *data,
     memcpy(pkt.h, header, 4);
     if (data && dlen) memcpy(pkt.p, data, dlen);
     ras_log(RAS_LOG_PROTOCOL, "Sending R-pkt: %zu bytes", dlen);
-    ras_net_sendto(net->rpc, &pkt, 4 + dlen, addr, port);
+    ras_net_reply(net, &pkt, 4 + dlen, addr, port);
 }
 
 static void send_d_pkt(ras_net *net, const unsigned char *rid, const void *data, size_t dlen, const char *addr, unsigned short port) {
@@ -278,7 +231,7 @@ static void send_d_pkt(ras_net *net, const unsigned char *rid, const void *data,
     if (dlen > sizeof(pkt.p)) dlen = sizeof(pkt.p);
     memcpy(pkt.h, header, 4);
     if (data && dlen) memcpy(pkt.p, data, dlen);
-    ras_net_sendto(net->rpc, &pkt, 4 + dlen, addr, port);
+    ras_net_reply(net, &pkt, 4 + dlen, addr, port);
 }
 
 static void send_d_pkt_with_offset(ras_net *net, const unsigned char *rid, uint32_t offset, const void *data, size_t dlen, const char *addr, unsigned short port) {
@@ -294,12 +247,12 @@ static void send_d_pkt_with_offset(ras_net *net, const unsigned char *rid, uint3
     header[3] = rid[2];
     write_u32(header + 4, offset);
     
-    struct { unsigned char h[8]; unsigned char p[2048]; } pkt;
+    struct { unsigned char h[8]; unsigned char p[RAS_MAX_READ_CHUNK]; } pkt;
     if (dlen > sizeof(pkt.p)) dlen = sizeof(pkt.p);
     memcpy(pkt.h, header, 8);
     if (data && dlen) memcpy(pkt.p, data, dlen);
     
-    ras_net_sendto(net->rpc, &pkt, 8 + dlen, addr, port);
+    ras_net_reply(net, &pkt, 8 + dlen, addr, port);
 }
 
 static void send_s_pkt(ras_net *net, const unsigned char *rid, const void *data, size_t dlen, const char *addr, unsigned short port) {
@@ -308,111 +261,263 @@ static void send_s_pkt(ras_net *net, const unsigned char *rid, const void *data,
     if (dlen > sizeof(pkt.p)) dlen = sizeof(pkt.p);
     memcpy(pkt.h, header, 4);
     if (data && dlen) memcpy(pkt.p, data, dlen);
-    ras_net_sendto(net->rpc, &pkt, 4 + dlen, addr, port);
+    ras_net_reply(net, &pkt, 4 + dlen, addr, port);
+}
+
+// D payload size for a client: the configured size, or the largest 1 KB
+// multiple that fits the path MTU unfragmented (IP 20 + UDP 8 + D header 8)
+static uint32_t read_chunk_for(const ras_config *cfg, const char *addr) {
+    if (cfg->server.read_chunk > 0) return (uint32_t)cfg->server.read_chunk;
+    int mtu = ras_net_path_mtu(addr);
+    if (mtu <= 36 + READ_CHUNK_MIN) return READ_CHUNK_MIN;
+    uint32_t chunk = ((uint32_t)mtu - 36) & ~(uint32_t)(READ_CHUNK_MIN - 1);
+    return chunk > RAS_MAX_READ_CHUNK ? RAS_MAX_READ_CHUNK : chunk;
+}
+
+// Stream D packets for [pos, limit) of the current window. At end of file
+// the transfer is cut short there. Returns 0 or an errno.
+static int send_read_data(ras_net *net, ras_transfer *pr, ras_handle *h, uint32_t pos, uint32_t limit, int max_packets) {
+    unsigned char data[RAS_MAX_READ_CHUNK];
+    for (int sent = 0; sent < max_packets && pos < limit; ++sent) {
+        uint32_t amount = limit - pos;
+        if (amount > pr->chunk) amount = pr->chunk;
+        ssize_t n = ras_fileio_read(h, data, amount, pos);
+        if (n < 0) return errno;
+        if (n == 0) {
+            pr->end_pos = pos;
+            break;
+        }
+        send_d_pkt_with_offset(net, pr->rid, pos - pr->start_pos, data, (size_t)n, pr->addr, pr->port);
+        pos += (uint32_t)n;
+        if ((uint32_t)n < amount) {
+            pr->end_pos = pos;
+            break;
+        }
+    }
+    return 0;
+}
+
+// Send the next window of the client's requested range and wait for the
+// per-packet r acks. Returns 0 or an errno.
+static int send_read_window(ras_net *net, ras_transfer *pr, ras_handle *h, uint32_t limit) {
+    if (limit > pr->end_pos) limit = pr->end_pos;
+    uint64_t span = (uint64_t)pr->chunk * (uint64_t)pr->window;
+    if (limit - pr->current_pos > span) limit = pr->current_pos + (uint32_t)span;
+
+    pr->last_pos = pr->current_pos;
+    pr->last_len = limit - pr->current_pos;
+    pr->burst = (int)((pr->last_len + pr->chunk - 1) / pr->chunk);
+    pr->acked = 0;
+    pr->state = RAS_READ_STATE_WAIT_DATA_ACK;
+
+    int rc = send_read_data(net, pr, h, pr->current_pos, limit, pr->burst);
+    if (rc != 0) return rc;
+    if (pr->end_pos < limit) {
+        // Hit end of file
+        pr->last_len = pr->end_pos - pr->last_pos;
+        pr->burst = (int)((pr->last_len + pr->chunk - 1) / pr->chunk);
+        limit = pr->end_pos;
+    }
+    pr->current_pos = limit;
+    if (pr->current_pos < pr->end_pos) ras_fileio_prefetch(h, pr->current_pos);
+    return 0;
+}
+
+static void send_read_done(ras_net *net, const ras_transfer *pr) {
+    unsigned char reply[8];
+    write_u32(reply, pr->end_pos - pr->start_pos);
+    write_u32(reply + 4, pr->end_pos);
+    send_r_pkt(net, pr->rid, reply, sizeof(reply), pr->addr, pr->port);
+}
+
+// Begin an RREAD: register the transfer and stream the first window
+static void start_read(const ras_config *cfg, ras_net *net, ras_transfer_table *transfers,
+                       ras_handle *h, int hid, const unsigned char *rid,
+                       uint32_t offset, uint32_t rlen, const char *addr, unsigned short port) {
+    ras_transfer *pr = ras_transfers_add(transfers, RAS_TRANSFER_READ, rid, addr, port);
+    if (!pr) {
+        send_err_pkt(net, rid, EMFILE, addr, port);
+        return;
+    }
+
+    pr->handle_id = hid;
+    pr->start_pos = offset;
+    pr->current_pos = offset;
+    pr->end_pos = offset + rlen;
+    pr->chunk = read_chunk_for(cfg, addr);
+    pr->window = cfg->server.read_window > 0 ? cfg->server.read_window : 1;
+
+    int rc = send_read_window(net, pr, h, pr->end_pos);
+    if (rc != 0) {
+        ras_transfers_remove(transfers, pr);
+        send_err_pkt(net, rid, rc, addr, port);
+        return;
+    }
+
+    // If the whole range went out at once (small file), send R packet too
+    if (pr->current_pos >= pr->end_pos) {
+        h->seq_ptr = pr->end_pos;
+        send_read_done(net, pr);
+        ras_transfers_remove(transfers, pr);
+    } else {
+        ras_transfers_sent(transfers, pr);
+    }
 }
 
 // Build FileDesc (20 bytes): load(4), exec(4), length(4), attrs(4), type(4)
-static void build_filedesc(unsigned char *out, const struct stat *st, uint32_t filetype) {
-    uint64_t cs = ras_time_to_riscos(st->st_mtime);
-    uint32_t load = ras_make_load_addr(filetype, cs);
-    uint32_t exec = ras_make_exec_addr(cs);
+static void build_filedesc_info(unsigned char *out, const struct stat *st, const ras_xattr_info *info) {
     uint32_t len = S_ISDIR(st->st_mode) ? 0x800 : (uint32_t)st->st_size;  // 0x800 for dirs
-    uint32_t attrs = ras_mode_to_attrs(st->st_mode);
     uint32_t type = S_ISDIR(st->st_mode) ? RAS_TYPE_DIR : RAS_TYPE_FILE;
 
-    write_u32(out, load);
-    write_u32(out + 4, exec);
+    write_u32(out, info->load);
+    write_u32(out + 4, info->exec);
     write_u32(out + 8, len);
-    write_u32(out + 12, attrs);
+    write_u32(out + 12, info->attrs);
     write_u32(out + 16, type);
 }
 
-// Build directory entries only (without header/trailer)
-// Returns the number of bytes written
-static size_t build_dir_entries(const char *dir_path, const ras_config *cfg, unsigned char *out, size_t out_sz, size_t start_entry) {
-    DIR *d = opendir(dir_path);
-    if (!d) return 0;
+static void build_filedesc(unsigned char *out, const struct stat *st, uint32_t filetype) {
+    uint64_t cs = ras_time_to_riscos(st->st_mtime);
+    ras_xattr_info info;
+    info.load = ras_make_load_addr(filetype, cs);
+    info.exec = ras_make_exec_addr(cs);
+    info.attrs = ras_mode_to_attrs(st->st_mode);
+    build_filedesc_info(out, st, &info);
+}
 
-    size_t offset = 0;
-    size_t entry_idx = 0;
-    struct dirent *ent;
+#define RAS_ATTR_ACCESS (RAS_ATTR_R | RAS_ATTR_W | RAS_ATTR_r | RAS_ATTR_w)
 
-    while ((ent = readdir(d)) != NULL) {
-        if (ent->d_name[0] == '.') continue;
+// Typed files take their date from mtime, which RSETINFO also sets, so
+// writes made later still date the file; host permissions stay
+// authoritative for R/W/r/w
+static void merge_host_details(const struct stat *st, ras_xattr_info *info) {
+    if ((info->load & 0xFFF00000u) == 0xFFF00000u) {
+        uint64_t cs = ras_time_to_riscos(st->st_mtime);
+        info->load = ras_make_load_addr(ras_get_filetype(info->load), cs);
+        info->exec = ras_make_exec_addr(cs);
+    }
+    info->attrs = (info->attrs & ~(uint32_t)RAS_ATTR_ACCESS) | ras_mode_to_attrs(st->st_mode);
+}
 
-        if (entry_idx < start_entry) {
-            entry_idx++;
-            continue;
-        }
+// Details a metadata = xattr share stored for a file
+static int stored_info(int metadata, const char *host_path, const struct stat *st, ras_xattr_info *info) {
+    if (metadata != RAS_METADATA_XATTR || !S_ISREG(st->st_mode)) return -1;
+    if (ras_xattr_get(host_path, info) != 0) return -1;
+    merge_host_details(st, info);
+    return 0;
+}
 
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, ent->d_name);
+// Load, exec and attributes of a host object as RISC OS sees them
+static void object_info(const ras_config *cfg, const char *host_path, const struct stat *st, ras_xattr_info *info) {
+    const ras_share_config *share = ras_hostfs_share(host_path);
+    if (share && stored_info(share->metadata, host_path, st, info) == 0) return;
 
-        struct stat st;
-        if (stat(full_path, &st) != 0) continue;
+    uint32_t filetype = S_ISDIR(st->st_mode) ? RAS_FILETYPE_DIR : ras_filetype_from_ext(host_path, cfg);
+    uint64_t cs = ras_time_to_riscos(st->st_mtime);
+    info->load = ras_make_load_addr(filetype, cs);
+    info->exec = ras_make_exec_addr(cs);
+    info->attrs = ras_mode_to_attrs(st->st_mode);
+}
 
-        uint32_t filetype = S_ISDIR(st.st_mode) ? RAS_FILETYPE_DIR : ras_filetype_from_ext(ent->d_name, cfg);
+static void describe_object(const ras_config *cfg, const char *host_path, const struct stat *st, unsigned char *out) {
+    ras_xattr_info info;
+    object_info(cfg, host_path, st, &info);
+    build_filedesc_info(out, st, &info);
+}
 
-        // Strip ,xxx suffix from name for display to RISC OS
-        char display_name[256];
-        ras_strip_type_suffix(ent->d_name, display_name, sizeof(display_name));
+// Keep a handle's load/exec and attributes in its file's extended
+// attributes, if its share stores them there. Returns 0 once stored.
+static int store_handle_info(ras_handle *h) {
+    if (h->type != RAS_HANDLE_FILE || !h->path) return -1;
+    const ras_share_config *share = ras_hostfs_share(h->path);
+    if (!share || share->metadata != RAS_METADATA_XATTR) return -1;
+    ras_xattr_info info = { h->load_addr, h->exec_addr, h->attrs };
+    if (ras_xattr_set(h->fd, h->path, &info) != 0) {
+        ras_log(RAS_LOG_DEBUG, "RSETINFO: no extended attributes on '%s' (errno=%d)", h->path, errno);
+        return -1;
+    }
+    return 0;
+}
 
-        // Entry: FileDesc(20) + name + null + padding to 4-byte
-        size_t name_len = strlen(display_name);
-        size_t entry_size = 20 + name_len + 1;
-        entry_size = (entry_size + 3) & ~3u;  // Align to 4 bytes
+// Entry bytes that fit in one catalogue or RREADDIR datagram
+#define RAS_DIR_PAGE_BYTES 1800
 
-        if (offset + entry_size > out_sz) break;
+// Marker in a catalogue trailer when no entries follow the page
+#define RAS_DIR_END 0xFFFFFFFFu
 
-        build_filedesc(out + offset, &st, filetype);
-        memcpy(out + offset + 20, display_name, name_len + 1);
-        // Zero padding
-        size_t pad_start = 20 + name_len + 1;
-        while (pad_start < entry_size) {
-            out[offset + pad_start++] = 0;
-        }
+// Encode entries from start_entry by index straight into a packet.
+// Returns the number of bytes written; *next is the first entry left
+// for the following page.
+static size_t build_dir_entries(const ras_dir_snapshot *snap, unsigned char *out, size_t out_sz,
+                                size_t start_entry, size_t *next) {
+    *next = start_entry;
+    if (!snap) return 0;
 
+    size_t offset = 0;
+    size_t i = start_entry;
+    for (; i < snap->count; ++i) {
+        const unsigned char *entry;
+        size_t entry_size = ras_dircache_entry(snap, i, &entry);
+        if (offset + entry_size > out_sz) break;
+        memcpy(out + offset, entry, entry_size);
         offset += entry_size;
-        entry_idx++;
     }
-
-    closedir(d);
+    *next = i;
     return offset;
 }
 
-// Send a combined S+B response for directory catalogue
+// Trailer marker: index of the next entry to ask for with RREADDIR, or
+// RAS_DIR_END once the listing is complete
+static uint32_t dir_page_marker(const ras_dir_snapshot *snap, size_t next) {
+    return snap && next < snap->count ? (uint32_t)next : RAS_DIR_END;
+}
+
+// Size of a catalogue reply: S(4) + header(8) + entries + B(4) + trailer(32)
+#define RAS_CATALOGUE_MAX (4 + 8 + RAS_DIR_PAGE_BYTES + 4 + 32)
+
+// Offsets of the per-request fields in a catalogue reply of length len
+#define CATALOGUE_B_RID(len)     ((len) - 36 + 1)
+#define CATALOGUE_SHARE_VAL(len) ((len) - 32 + 16)
+#define CATALOGUE_HANDLE(len)    ((len) - 32 + 20)
+
+// Fill in the reply ID and handle of an encoded catalogue reply
+static void patch_catalogue(unsigned char *pkt, size_t len, const unsigned char *rid, int handle) {
+    memcpy(pkt + 1, rid, 3);
+    memcpy(pkt + CATALOGUE_B_RID(len), rid, 3);
+    write_u32(pkt + CATALOGUE_SHARE_VAL(len), (((uint32_t)handle) & 0xFFFFFF00) ^ 0xFFFFFF02);
+    write_u32(pkt + CATALOGUE_HANDLE(len), (uint32_t)handle);
+}
+
+// Encode the first page of a listing as a combined S+B catalogue reply
+// with the reply ID and handle left blank. Entries that do not fit are
+// left for RREADDIR, starting at the index in the marker, which is
+// returned in *next.
 // Format: S+rid + [content_len, trailer_len, ...entries...] + B+rid + [load, exec, len, access, share_val, handle, content_len, marker]
-static void send_catalogue_response(ras_net *net, const unsigned char *rid, const char *dir_path, 
-                                     const ras_config *cfg, int handle, const char *addr, unsigned short port) {
-    // Buffer for combined packet: S(4) + header(8) + entries(up to 1900) + B(4) + trailer(32)
-    unsigned char pkt[2048];
+static size_t encode_catalogue(unsigned char *pkt, const ras_dir_snapshot *snap, size_t *next) {
     size_t offset = 0;
 
     // S + reply_id
     pkt[offset++] = 'S';
-    pkt[offset++] = rid[0];
-    pkt[offset++] = rid[1];
-    pkt[offset++] = rid[2];
+    pkt[offset++] = 0;
+    pkt[offset++] = 0;
+    pkt[offset++] = 0;
 
-    // Build entries into temp buffer to get length
-    unsigned char entries[1800];
-    size_t entries_len = build_dir_entries(dir_path, cfg, entries, sizeof(entries), 0);
+    // Entries go straight in after the header, which is filled in once
+    // their length is known
+    size_t entries_len = build_dir_entries(snap, pkt + offset + 8, RAS_DIR_PAGE_BYTES, 0, next);
 
     // Header: content_len (length of entries), trailer_len (0x24 = 36 bytes = B+rid + 8 words)
     write_u32(pkt + offset, (uint32_t)entries_len);
     offset += 4;
     write_u32(pkt + offset, 0x24);  // Trailer length = 36 bytes (includes B+rid)
     offset += 4;
-
-    // Entries
-    memcpy(pkt + offset, entries, entries_len);
     offset += entries_len;
 
     // B + reply_id
     pkt[offset++] = 'B';
-    pkt[offset++] = rid[0];
-    pkt[offset++] = rid[1];
-    pkt[offset++] = rid[2];
+    pkt[offset++] = 0;
+    pkt[offset++] = 0;
+    pkt[offset++] = 0;
 
     // Trailer (8 words = 32 bytes): load, exec, rounded_len, access, share_val, handle, content_len, marker
     // Python uses fixed 0xffffcd00, 0x00000000 for load/exec in trailer
@@ -420,26 +525,45 @@ static void send_catalogue_response(ras_net *net, const unsigned char *rid, cons
     uint32_t exec = 0x00000000;
     uint32_t rounded_len = ((uint32_t)entries_len + 2047) & ~2047u;
     uint32_t access = 0x13;  // Read-only for others, RW for owner
-    uint32_t share_val = (((uint32_t)handle) & 0xFFFFFF00) ^ 0xFFFFFF02;
-    uint32_t marker = 0xFFFFFFFF;  // End marker
 
     write_u32(pkt + offset, load);         offset += 4;
     write_u32(pkt + offset, exec);         offset += 4;
     write_u32(pkt + offset, rounded_len);  offset += 4;
     write_u32(pkt + offset, access);       offset += 4;
-    write_u32(pkt + offset, share_val);    offset += 4;
-    write_u32(pkt + offset, (uint32_t)handle); offset += 4;
+    write_u32(pkt + offset, 0);            offset += 4;  // share_val
+    write_u32(pkt + offset, 0);            offset += 4;  // handle
     write_u32(pkt + offset, (uint32_t)entries_len); offset += 4;
-    write_u32(pkt + offset, marker);       offset += 4;
+    write_u32(pkt + offset, dir_page_marker(snap, *next)); offset += 4;
+    return offset;
+}
 
-    ras_log(RAS_LOG_PROTOCOL, "Sending S+B catalogue: %zu bytes, %zu entries_len, handle=%d", offset, entries_len, handle);
-    ras_net_sendto(net->rpc, pkt, offset, addr, port);
+// Send a combined S+B response for directory catalogue, patched from the
+// listing's prebuilt reply when it has one. Returns the index of the
+// first entry not sent.
+static size_t send_catalogue_response(ras_net *net, const unsigned char *rid, const ras_dir_snapshot *snap,
+                                      int handle, const char *addr, unsigned short port) {
+    unsigned char pkt[RAS_CATALOGUE_MAX];
+    size_t len;
+    size_t next;
+    if (snap && snap->page) {
+        len = snap->page_len;
+        next = snap->page_next;
+        memcpy(pkt, snap->page, len);
+    } else {
+        len = encode_catalogue(pkt, snap, &next);
+    }
+    patch_catalogue(pkt, len, rid, handle);
+
+    ras_log(RAS_LOG_PROTOCOL, "Sending S+B catalogue: %zu bytes, handle=%d, next=%zu", len, handle, next);
+    ras_net_reply(net, pkt, len, addr, port);
+    return next;
 }
 
-// Send S+B response for RREADDIR (next chunk)
-static void send_readdir_response(ras_net *net, const unsigned char *rid, const char *dir_path,
-                                   const ras_config *cfg, int handle, size_t start_entry, const char *addr, unsigned short port) {
-    unsigned char pkt[2048];
+// Send S+B response for RREADDIR (next chunk). Returns the index of the
+// entry after the last one sent.
+static size_t send_readdir_response(ras_net *net, const unsigned char *rid, const ras_dir_snapshot *snap,
+                                    size_t start_entry, const char *addr, unsigned short port) {
+    unsigned char pkt[4 + 8 + RAS_DIR_PAGE_BYTES + 4 + 8];
     size_t offset = 0;
 
     // S + reply_id
@@ -448,18 +572,15 @@ static void send_readdir_response(ras_net *net, const unsigned char *rid, const
     pkt[offset++] = rid[1];
     pkt[offset++] = rid[2];
 
-    // Build entries
-    unsigned char entries[1800];
-    size_t entries_len = build_dir_entries(dir_path, cfg, entries, sizeof(entries), start_entry);
+    // Entries straight into the packet after the header
+    size_t next;
+    size_t entries_len = build_dir_entries(snap, pkt + offset + 8, RAS_DIR_PAGE_BYTES, start_entry, &next);
 
     // Header: content_len, trailer_len (0x0c = 12 bytes for readdir)
     write_u32(pkt + offset, (uint32_t)entries_len);
     offset += 4;
     write_u32(pkt + offset, 0x0c);
     offset += 4;
-
-    // Entries
-    memcpy(pkt + offset, entries, entries_len);
     offset += entries_len;
 
     // B + reply_id
@@ -469,11 +590,333 @@ static void send_readdir_response(ras_net *net, const unsigned char *rid, const
     pkt[offset++] = rid[2];
 
     // Trailer for readdir (3 words = 12 bytes): [content_len, marker]
-    uint32_t marker = 0xFFFFFFFF;  // End marker
+    uint32_t marker = dir_page_marker(snap, next);
     write_u32(pkt + offset, (uint32_t)entries_len); offset += 4;
     write_u32(pkt + offset, marker); offset += 4;
 
-    ras_net_sendto(net->rpc, pkt, offset, addr, port);
+    ras_net_reply(net, pkt, offset, addr, port);
+    return next;
+}
+
+// Order wire-format entries by name, ignoring case as the Filer does
+static int compare_entry_names(const void *a, const void *b) {
+    const char *na = (const char *)(*(const unsigned char *const *)a + 20);
+    const char *nb = (const char *)(*(const unsigned char *const *)b + 20);
+    int r = strcasecmp(na, nb);
+    return r != 0 ? r : strcmp(na, nb);
+}
+
+// What fill_dir_snapshot needs besides the directory's path
+typedef struct {
+    const ras_config *cfg;
+    int dir_fd;             // Open directory, or -1 to open by path
+    int stat_threads;       // From the directory's share
+    int metadata;           // Likewise, RAS_METADATA_*
+} dir_fill_ctx;
+
+// Read a directory into wire-format entries for the directory cache
+static int fill_dir_snapshot(ras_dir_snapshot *snap, const char *dir_path, void *ctx) {
+    const dir_fill_ctx *fc = (const dir_fill_ctx *)ctx;
+    const ras_config *cfg = fc->cfg;
+
+#ifdef _WIN32
+    DIR *d = opendir(dir_path);
+    if (!d) return -1;
+#else
+    // Reopen through the handle's directory fd when there is one, so
+    // the path is not resolved again
+    int dfd = fc->dir_fd >= 0 ? openat(fc->dir_fd, ".", O_RDONLY | O_DIRECTORY) : ras_hostfs_open_dir(dir_path);
+    if (dfd < 0) return -1;
+    DIR *d = fdopendir(dfd);
+    if (!d) {
+        close(dfd);
+        return -1;
+    }
+#endif
+
+    // Names first, so that their details can be fetched concurrently
+    char *pool = NULL;
+    size_t pool_len = 0, pool_cap = 0;
+    size_t *name_off = NULL;
+    size_t count = 0, count_cap = 0;
+    int rc = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        size_t n = strlen(ent->d_name) + 1;
+        if (pool_len + n > pool_cap) {
+            size_t cap = pool_cap ? pool_cap * 2 : 4096;
+            while (cap < pool_len + n) cap *= 2;
+            char *p = (char *)realloc(pool, cap);
+            if (!p) { rc = -1; break; }
+            pool = p;
+            pool_cap = cap;
+        }
+        if (count == count_cap) {
+            size_t cap = count_cap ? count_cap * 2 : 64;
+            size_t *p = (size_t *)realloc(name_off, cap * sizeof(size_t));
+            if (!p) { rc = -1; break; }
+            name_off = p;
+            count_cap = cap;
+        }
+        memcpy(pool + pool_len, ent->d_name, n);
+        name_off[count++] = pool_len;
+        pool_len += n;
+
+        // Every name can be found regardless of case
+        if (ras_dircache_add_host_name(snap, ent->d_name, n - 1, ent->d_name) != 0) {
+            rc = -1;
+            break;
+        }
+    }
+
+    // Typed files are also found from their base name, after the exact
+    // names so that a file without a suffix wins
+    for (size_t i = 0; rc == 0 && i < count; ++i) {
+        const char *name = pool + name_off[i];
+        size_t n = strlen(name);
+        if (n > 4 && name[n - 4] == ',' && ras_filetype_from_suffix(name) >= 0 &&
+            ras_dircache_add_host_name(snap, name, n - 4, name) != 0) {
+            rc = -1;
+        }
+    }
+
+    const char **names = NULL;
+    struct stat *sts = NULL;
+    int *ok = NULL;
+    if (rc == 0 && count > 0) {
+        names = (const char **)malloc(count * sizeof(*names));
+        sts = (struct stat *)malloc(count * sizeof(*sts));
+        ok = (int *)malloc(count * sizeof(*ok));
+        if (!names || !sts || !ok) rc = -1;
+    }
+    if (rc == 0 && count > 0) {
+        for (size_t i = 0; i < count; ++i) names[i] = pool + name_off[i];
+#ifdef _WIN32
+        // No directory fds, so each entry is looked up by its full path
+        char full_path[1024];
+        for (size_t i = 0; i < count; ++i) {
+            int n = snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, names[i]);
+            ok[i] = n > 0 && (size_t)n < sizeof(full_path) && ras_hostfs_stat(full_path, &sts[i]) == 0;
+        }
+#else
+        // Entries are looked up by name in the open directory
+        ras_statpool_stat(dirfd(d), names, count, sts, ok, fc->stat_threads);
+#endif
+    }
+
+    // Details just read serve the lookups that follow a catalogue
+    char entry_path[1024];
+    size_t dir_len = strlen(dir_path);
+    for (size_t i = 0; rc == 0 && i < count; ++i) {
+        if (!ok[i]) continue;
+        const struct stat *st = &sts[i];
+        int have_path = dir_len + 1 + strlen(names[i]) < sizeof(entry_path);
+        if (have_path) {
+            memcpy(entry_path, dir_path, dir_len);
+            entry_path[dir_len] = '/';
+            strcpy(entry_path + dir_len + 1, names[i]);
+            ras_attrcache_put(entry_path, st);
+        }
+
+        // Strip ,xxx suffix from name for display to RISC OS
+        char display_name[256];
+        ras_strip_type_suffix(names[i], display_name, sizeof(display_name));
+
+        // Entry: FileDesc(20) + name + null + padding to 4-byte
+        unsigned char entry[20 + sizeof(display_name) + 3];
+        size_t name_len = strlen(display_name);
+        size_t entry_size = 20 + name_len + 1;
+        entry_size = (entry_size + 3) & ~3u;  // Align to 4 bytes
+
+        // Stored details are read once per listing and kept with it
+        ras_xattr_info info;
+        if (have_path && stored_info(fc->metadata, entry_path, st, &info) == 0) {
+            build_filedesc_info(entry, st, &info);
+        } else {
+            build_filedesc(entry, st, S_ISDIR(st->st_mode) ? RAS_FILETYPE_DIR : ras_filetype_from_ext(names[i], cfg));
+        }
+        memcpy(entry + 20, display_name, name_len + 1);
+        memset(entry + 20 + name_len + 1, 0, entry_size - (20 + name_len + 1));
+
+        if (ras_dircache_add_entry(snap, entry, entry_size) != 0) rc = -1;
+    }
+
+    free(names);
+    free(sts);
+    free(ok);
+    free(name_off);
+    free(pool);
+    closedir(d);
+    if (rc != 0) return -1;
+
+    // Name order, so paging through a listing is independent of readdir()
+    if (ras_dircache_sort(snap, compare_entry_names) != 0) return -1;
+
+    // Encode the catalogue reply once per directory version; requests
+    // only patch in their reply ID and handle
+    snap->page = (unsigned char *)malloc(RAS_CATALOGUE_MAX);
+    if (snap->page) snap->page_len = encode_catalogue(snap->page, snap, &snap->page_next);
+    return 0;
+}
+
+// Listing of a directory, read through dir_fd if it is open (else -1)
+static ras_dir_snapshot *get_listing(const ras_config *cfg, const char *dir_path, int dir_fd) {
+    const ras_share_config *share = ras_hostfs_share(dir_path);
+    dir_fill_ctx fc = { cfg, dir_fd, share ? share->stat_threads : 1, share ? share->metadata : RAS_METADATA_SUFFIX };
+    return ras_dircache_get(dir_path, fill_dir_snapshot, &fc);
+}
+
+// Entries of a directory handle, captured on first use and kept for the
+// life of the handle so that paging sees one consistent listing
+static const ras_dir_snapshot *dir_listing(const ras_config *cfg, ras_handle *h) {
+    if (!h) return NULL;
+    if (!h->listing) h->listing = get_listing(cfg, h->path, h->dir_fd);
+    return h->listing;
+}
+
+// Keep a new directory handle's directory open for reading its listing
+static ras_handle *open_dir_handle(ras_handle_table *handles, int hid) {
+    ras_handle *h = NULL;
+    if (ras_handles_get(handles, hid, &h) != 0 || !h) return NULL;
+#ifndef _WIN32
+    if (h->path) h->dir_fd = ras_hostfs_open_dir(h->path);
+#endif
+    return h;
+}
+
+// On-disk name in dir_path matching name regardless of case, or a typed
+// file name,xxx for it. Uses the directory's cached listing, or scans the
+// directory when listings are not cached.
+static int match_in_dir(const ras_config *cfg, const char *dir_path, const char *name, size_t name_len,
+                        char *out, size_t out_sz) {
+    if (ras_dircache_enabled()) {
+        ras_dir_snapshot *snap = get_listing(cfg, dir_path, -1);
+        if (!snap) return -1;
+        const char *host_name = ras_dircache_host_name(snap, name, name_len);
+        if (host_name) snprintf(out, out_sz, "%s", host_name);
+        ras_dircache_release(snap);
+        return host_name ? 0 : -1;
+    }
+
+#ifdef _WIN32
+    DIR *d = opendir(dir_path);
+    if (!d) return -1;
+#else
+    int dfd = ras_hostfs_open_dir(dir_path);
+    if (dfd < 0) return -1;
+    DIR *d = fdopendir(dfd);
+    if (!d) {
+        close(dfd);
+        return -1;
+    }
+#endif
+
+    // An exact name beats a typed one wherever they come in the directory
+    int found = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        size_t ent_len = strlen(ent->d_name);
+        if (strncasecmp(ent->d_name, name, name_len) != 0) continue;
+        if (ent_len == name_len) {
+            snprintf(out, out_sz, "%s", ent->d_name);
+            found = 1;
+            break;
+        }
+        if (!found && ent_len == name_len + 4 && ent->d_name[name_len] == ',' &&
+            ras_filetype_from_suffix(ent->d_name) >= 0) {
+            snprintf(out, out_sz, "%s", ent->d_name);
+            found = 1;
+        }
+    }
+    closedir(d);
+    return found ? 0 : -1;
+}
+
+// Details of a host file, from the attribute cache while they are fresh
+static int host_stat(const char *host_path, struct stat *st) {
+    if (ras_attrcache_get(host_path, st) == 0) return 0;
+    if (ras_hostfs_stat(host_path, st) != 0) return -1;
+    ras_attrcache_put(host_path, st);
+    return 0;
+}
+
+// Host path and details of the file or directory a RISC OS path names.
+// Names match regardless of case and of a ,xxx suffix; the outcome is
+// remembered in the path cache so repeated lookups need no directory
+// scans. Returns -1 with errno set if there is no such object.
+static int find_host_path(const ras_config *cfg, const char *ro_path, char *out, size_t out_sz, struct stat *st) {
+    int known = ras_pathcache_find(ro_path, out, out_sz);
+    if (known == RAS_PATHCACHE_MISSING) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    char host_path[512];
+    const ras_share_config *share = share_for_path(cfg, ro_path);
+    if (!share || resolve_path(cfg, ro_path, host_path, sizeof(host_path)) != 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    // Names given in the host's own case need no more than this, and win
+    // over a differently named match remembered before they existed
+    if (host_stat(host_path, st) == 0) {
+        if (known != RAS_PATHCACHE_FOUND || strcmp(out, host_path) != 0) {
+            snprintf(out, out_sz, "%s", host_path);
+            ras_pathcache_store_found(ro_path, out);
+        }
+        return 0;
+    }
+    if (known == RAS_PATHCACHE_FOUND && host_stat(out, st) == 0) return 0;
+
+    // Otherwise match each component that is not there as given
+    if (share->path_len >= out_sz) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(out, share->path, share->path_len + 1);
+    size_t len = share->path_len;
+    const char *rest = host_path + share->path_len;
+    while (*rest == '/') {
+        rest++;
+        const char *end = strchr(rest, '/');
+        size_t comp_len = end ? (size_t)(end - rest) : strlen(rest);
+        if (comp_len == 0) continue;
+        if (len + 1 + comp_len >= out_sz) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        struct stat comp_st;
+        out[len] = '/';
+        memcpy(out + len + 1, rest, comp_len);
+        out[len + 1 + comp_len] = '\0';
+        if (ras_hostfs_stat(out, &comp_st) != 0) {
+            out[len] = '\0';
+            ras_dir_stamp stamp;
+            int64_t seen_sec = (int64_t)time(NULL);
+            int have_stamp = ras_dircache_read_stamp(out, &stamp) == 0;
+
+            char name[256];
+            if (match_in_dir(cfg, out, rest, comp_len, name, sizeof(name)) != 0) {
+                if (have_stamp) ras_pathcache_store_missing(ro_path, out, &stamp, seen_sec);
+                errno = ENOENT;
+                return -1;
+            }
+            int n = snprintf(out + len, out_sz - len, "/%s", name);
+            if (n < 0 || (size_t)n >= out_sz - len) {
+                errno = ENAMETOOLONG;
+                return -1;
+            }
+        }
+        len = strlen(out);
+        rest += comp_len;
+    }
+
+    if (host_stat(out, st) != 0) return -1;
+    ras_pathcache_store_found(ro_path, out);
+    return 0;
 }
 
 // Check if client is authorized to access a share (returns 1 if OK, 0 if denied)
@@ -481,33 +924,25 @@ static int check_share_auth(const ras_config *cfg, ras_auth_state *auth,
                             const char *client_ip, const char *ro_path) {
     if (!cfg || !ro_path) return 0;
     
-    // Extract share name from RISC OS path
-    const char *dot = strchr(ro_path, '.');
-    size_t share_len = dot ? (size_t)(dot - ro_path) : strlen(ro_path);
-    
-    // Find the share
-    for (size_t i = 0; i < cfg->share_count; ++i) {
-        const char *name = cfg->shares[i].name;
-        if (name && strlen(name) == share_len && strncasecmp(name, ro_path, share_len) == 0) {
-            // Found the share - check if protected
-            if (!(cfg->shares[i].attributes & RAS_ATTR_PROTECTED)) {
-                return 1;  // Not protected, allow
-            }
-            // Protected - check if client is authenticated
-            if (auth && ras_auth_check(auth, client_ip, name)) {
-                return 1;  // Authenticated
-            }
-            ras_log(RAS_LOG_DEBUG, "Auth denied: client %s not authenticated for share '%s'", 
-                    client_ip ? client_ip : "?", name);
-            return 0;  // Denied
-        }
+    const ras_share_config *share = share_for_path(cfg, ro_path);
+    if (!share) return 0;  // Share not found
+
+    // Found the share - check if protected
+    if (!(share->attributes & RAS_ATTR_PROTECTED)) {
+        return 1;  // Not protected, allow
     }
-    return 0;  // Share not found
+    // Protected - check if client is authenticated
+    if (auth && ras_auth_check(auth, client_ip, share->name)) {
+        return 1;  // Authenticated
+    }
+    ras_log(RAS_LOG_DEBUG, "Auth denied: client %s not authenticated for share '%s'", 
+            client_ip ? client_ip : "?", share->name);
+    return 0;  // Denied
 }
 
-int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsigned short port,
-                   const ras_config *cfg, ras_net *net, ras_handle_table *handles, ras_auth_state *auth) {
-    if (!buf || len < 4 || !net || !cfg || !handles) return -1;
+static int dispatch_rpc(const unsigned char *buf, size_t len, const char *addr, unsigned short port,
+                        const ras_config *cfg, ras_net *net, ras_handle_table *handles,
+                        ras_transfer_table *transfers, ras_auth_state *auth) {
 
     unsigned char cmd = buf[0];
     unsigned char rid[3] = { buf[1], buf[2], buf[3] };
@@ -554,24 +989,15 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         switch (code) {
         case 0x00: // RFIND
         {
-            if (resolve_path(cfg, path, host_path, sizeof(host_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
-            // Try to find file with ,xxx suffix if exact path doesn't exist
+            // Match the name regardless of case or ,xxx suffix
             char actual_path[512];
-            if (find_file_with_suffix(host_path, actual_path, sizeof(actual_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
             struct stat st;
-            if (stat(actual_path, &st) != 0) {
-                send_err_pkt(net, rid, errno, addr, port);
+            if (find_host_path(cfg, path, actual_path, sizeof(actual_path), &st) != 0) {
+                send_err_pkt(net, rid, ENOENT, addr, port);
                 break;
             }
-            uint32_t filetype = S_ISDIR(st.st_mode) ? RAS_FILETYPE_DIR : ras_filetype_from_ext(actual_path, cfg);
             unsigned char desc[20];
-            build_filedesc(desc, &st, filetype);
+            describe_object(cfg, actual_path, &st, desc);
             send_r_pkt(net, rid, desc, sizeof(desc), addr, port);
             break;
         }
@@ -579,24 +1005,11 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         case 0x01: // ROPENIN (open for reading)
         case 0x02: // ROPENUP (open for read/write)
         {
-            if (resolve_path(cfg, path, host_path, sizeof(host_path)) != 0) {
-                // If path is empty, they're asking about the share itself
-                if (path[0] == '\0') {
-                    send_err_pkt(net, rid, ENOENT, addr, port);
-                    break;
-                }
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
-            // Try to find file with ,xxx suffix if exact path doesn't exist
+            // Match the name regardless of case or ,xxx suffix
             char actual_path[512];
-            if (find_file_with_suffix(host_path, actual_path, sizeof(actual_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
             struct stat st;
-            if (stat(actual_path, &st) != 0) {
-                send_err_pkt(net, rid, errno, addr, port);
+            if (find_host_path(cfg, path, actual_path, sizeof(actual_path), &st) != 0) {
+                send_err_pkt(net, rid, ENOENT, addr, port);
                 break;
             }
 
@@ -613,6 +1026,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                     send_err_pkt(net, rid, EMFILE, addr, port);
                     break;
                 }
+                open_dir_handle(handles, hid);
 
                 // Reply: FileDesc(20) + handle(4)
                 unsigned char reply[24];
@@ -622,27 +1036,28 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             } else {
                 // It's a file
                 int flags = (code == 0x01) ? O_RDONLY : O_RDWR;
-                int fd = open(actual_path, flags);
+                int fd = ras_hostfs_open(actual_path, flags, 0);
                 if (fd < 0) {
                     send_err_pkt(net, rid, errno, addr, port);
                     break;
                 }
-                uint32_t filetype = ras_filetype_from_ext(actual_path, cfg);
-                uint64_t cs = ras_time_to_riscos(st.st_mtime);
+                ras_xattr_info info;
+                object_info(cfg, actual_path, &st, &info);
 
                 int hid = 0, tok = 0;
                 if (ras_handles_add_ex(handles, RAS_HANDLE_FILE, fd, actual_path,
-                                       ras_make_load_addr(filetype, cs), ras_make_exec_addr(cs),
-                                       (uint32_t)st.st_size, ras_mode_to_attrs(st.st_mode),
+                                       info.load, info.exec,
+                                       (uint32_t)st.st_size, info.attrs,
                                        &hid, &tok) != 0) {
                     close(fd);
                     send_err_pkt(net, rid, EMFILE, addr, port);
                     break;
                 }
+                if (code == 0x02) set_write_buffer(cfg, handles, hid, path);
 
                 // Reply: FileDesc(20) + handle(4)
                 unsigned char reply[24];
-                build_filedesc(reply, &st, filetype);
+                build_filedesc_info(reply, &st, &info);
                 write_u32(reply + 20, (uint32_t)hid);
                 send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
             }
@@ -651,12 +1066,8 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
 
         case 0x03: // ROPENDIR
         {
-            if (resolve_path(cfg, path, host_path, sizeof(host_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
             struct stat st;
-            if (stat(host_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            if (find_host_path(cfg, path, host_path, sizeof(host_path), &st) != 0 || !S_ISDIR(st.st_mode)) {
                 send_err_pkt(net, rid, ENOTDIR, addr, port);
                 break;
             }
@@ -667,6 +1078,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 send_err_pkt(net, rid, EMFILE, addr, port);
                 break;
             }
+            dir_listing(cfg, open_dir_handle(handles, hid));
             // Return handle + token in R response
             unsigned char reply[8];
             write_u32(reply, (uint32_t)hid);
@@ -688,13 +1100,14 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             char *last_slash = strrchr(parent, '/');
             if (last_slash && last_slash != parent) {
                 *last_slash = '\0';
-                mkpath(parent, 0775);
+                ras_hostfs_mkpath(parent, 0775);
             }
-            int fd = open(host_path, O_CREAT | O_TRUNC | O_RDWR, 0664);
+            int fd = ras_hostfs_open(host_path, O_CREAT | O_TRUNC | O_RDWR, 0664);
             if (fd < 0) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
             }
+            object_changed(host_path, path);
             struct stat st;
             fstat(fd, &st);
             uint32_t filetype = ras_filetype_from_ext(host_path, cfg);
@@ -709,6 +1122,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 send_err_pkt(net, rid, EMFILE, addr, port);
                 break;
             }
+            set_write_buffer(cfg, handles, hid, path);
             unsigned char reply[24];
             build_filedesc(reply, &st, filetype);
             write_u32(reply + 20, (uint32_t)hid);
@@ -722,13 +1136,14 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 send_err_pkt(net, rid, ENOENT, addr, port);
                 break;
             }
-            // Use mkpath to create parent directories as needed
-            if (mkpath(host_path, 0775) != 0 && errno != EEXIST) {
+            // Create parent directories as needed
+            if (ras_hostfs_mkpath(host_path, 0775) != 0 && errno != EEXIST) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
             }
+            object_changed(host_path, path);
             struct stat st;
-            stat(host_path, &st);
+            ras_hostfs_stat(host_path, &st);
             int hid = 0, tok = 0;
             if (ras_handles_add_ex(handles, RAS_HANDLE_DIR, -1, host_path,
                                    0, 0, 0, ras_mode_to_attrs(st.st_mode),
@@ -736,6 +1151,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 send_err_pkt(net, rid, EMFILE, addr, port);
                 break;
             }
+            open_dir_handle(handles, hid);
             // Return FileDesc(20) + handle(4) = 24 bytes
             unsigned char reply[24];
             build_filedesc(reply, &st, RAS_FILETYPE_DIR);
@@ -746,27 +1162,21 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
 
         case 0x06: // RDELETE
         {
-            if (resolve_path(cfg, path, host_path, sizeof(host_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
-            // Try to find file with ,xxx suffix if exact path doesn't exist
+            // Match the name regardless of case or ,xxx suffix
             char actual_path[512];
-            if (find_file_with_suffix(host_path, actual_path, sizeof(actual_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
             struct stat st;
-            if (stat(actual_path, &st) != 0) {
-                send_err_pkt(net, rid, errno, addr, port);
+            if (find_host_path(cfg, path, actual_path, sizeof(actual_path), &st) != 0) {
+                send_err_pkt(net, rid, ENOENT, addr, port);
                 break;
             }
             unsigned char reply[20];
-            build_filedesc(reply, &st, S_ISDIR(st.st_mode) ? RAS_FILETYPE_DIR : ras_filetype_from_ext(actual_path, cfg));
+            describe_object(cfg, actual_path, &st, reply);
             if (unlink(actual_path) != 0 && rmdir(actual_path) != 0) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
             }
+            object_changed(actual_path, path);
+            ras_dircache_invalidate(actual_path);
             send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
             break;
         }
@@ -777,19 +1187,11 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             if (len < 16) { send_err_pkt(net, rid, EINVAL, addr, port); break; }
             uint32_t new_attrs = read_u32(buf + 8);
             const char *attr_path = (len > 16) ? (const char *)(buf + 16) : "";
-            if (resolve_path(cfg, attr_path, host_path, sizeof(host_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
-            // Try to find file with ,xxx suffix if exact path doesn't exist
+            // Match the name regardless of case or ,xxx suffix
             char actual_path[512];
-            if (find_file_with_suffix(host_path, actual_path, sizeof(actual_path)) != 0) {
-                send_err_pkt(net, rid, ENOENT, addr, port);
-                break;
-            }
             struct stat st;
-            if (stat(actual_path, &st) != 0) {
-                send_err_pkt(net, rid, errno, addr, port);
+            if (find_host_path(cfg, attr_path, actual_path, sizeof(actual_path), &st) != 0) {
+                send_err_pkt(net, rid, ENOENT, addr, port);
                 break;
             }
             // Map to Unix mode
@@ -805,8 +1207,20 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 if (mode & 0004) mode |= 0001;  // other read -> other exec
             }
             chmod(actual_path, mode);
+
+            // Attributes without a host permission bit, such as locked,
+            // are kept only where the share stores RISC OS details
+            ras_xattr_info info;
+            object_info(cfg, actual_path, &st, &info);
+            const ras_share_config *share = ras_hostfs_share(actual_path);
+            if (share && share->metadata == RAS_METADATA_XATTR && S_ISREG(st.st_mode) &&
+                ((new_attrs & ~(uint32_t)RAS_ATTR_ACCESS) != (info.attrs & ~(uint32_t)RAS_ATTR_ACCESS))) {
+                info.attrs = new_attrs;
+                ras_xattr_set(-1, actual_path, &info);
+            }
+            object_changed(actual_path, attr_path);
             unsigned char reply[20];
-            build_filedesc(reply, &st, S_ISDIR(st.st_mode) ? RAS_FILETYPE_DIR : ras_filetype_from_ext(actual_path, cfg));
+            build_filedesc_info(reply, &st, &info);
             send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
             break;
         }
@@ -860,7 +1274,20 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         {
             // Format: cmd(1) + rid(3) + code(4) + handle(4) = 12 bytes
             int hid = (int)handle;
+            // Buffered writes that fail now are reported by the close
+            ras_handle *h = NULL;
+            int err = 0;
+            if (ras_handles_get(handles, hid, &h) == 0 && h) {
+                if (ras_fileio_flush(h) != 0) err = errno;
+                if (h->written) {
+                    object_changed(h->path, NULL);
+                }
+            }
             ras_handles_remove(handles, hid);
+            if (err != 0) {
+                send_err_pkt(net, rid, err, addr, port);
+                break;
+            }
             // Empty success reply
             send_r_pkt(net, rid, NULL, 0, addr, port);
             break;
@@ -881,55 +1308,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 break;
             }
             
-            // Allocate pending read
-            pending_read_t *pr = alloc_pending_read();
-            if (!pr) {
-                send_err_pkt(net, rid, EMFILE, addr, port);
-                break;
-            }
-            
-            pr->handle_id = hid;
-            pr->start_pos = offset;
-            pr->current_pos = offset;
-            pr->end_pos = offset + rlen;
-            pr->state = RAS_READ_STATE_WAIT_DATA_ACK;
-            pr->rid[0] = rid[0];
-            pr->rid[1] = rid[1];
-            pr->rid[2] = rid[2];
-            strncpy(pr->addr, addr, sizeof(pr->addr) - 1);
-            pr->addr[sizeof(pr->addr) - 1] = '\0';
-            pr->port = port;
-            
-            // Send first chunk
-            uint32_t amount = (rlen < READ_CHUNK_SIZE) ? rlen : READ_CHUNK_SIZE;
-            
-            if (lseek(h->fd, (off_t)pr->current_pos, SEEK_SET) < 0) {
-                free_pending_read(pr);
-                send_err_pkt(net, rid, errno, addr, port);
-                break;
-            }
-            
-            unsigned char data[READ_CHUNK_SIZE];
-            ssize_t n = read(h->fd, data, amount);
-            if (n < 0) {
-                free_pending_read(pr);
-                send_err_pkt(net, rid, errno, addr, port);
-                break;
-            }
-            
-            // Send D packet with offset relative to start (should be 0 for first chunk)
-            send_d_pkt_with_offset(net, rid, pr->current_pos - pr->start_pos, data, (size_t)n, addr, port);
-            
-            pr->current_pos += (uint32_t)n;
-            
-            // If completed immediately (small file), send R packet too
-            if (pr->current_pos >= pr->end_pos) {
-                 unsigned char reply[8];
-                 write_u32(reply, pr->end_pos - pr->start_pos);
-                 write_u32(reply + 4, pr->end_pos);
-                 send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
-                 free_pending_read(pr);
-            }
+            start_read(cfg, net, transfers, h, hid, rid, offset, rlen, addr, port);
             break;
         }
 
@@ -962,7 +1341,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             }
             
             // Allocate pending write state
-            pending_write_t *pw = alloc_pending_write();
+            ras_transfer *pw = ras_transfers_add(transfers, RAS_TRANSFER_WRITE, rid, addr, port);
             if (!pw) {
                 send_err_pkt(net, rid, ENOMEM, addr, port);
                 break;
@@ -972,17 +1351,17 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             pw->start_pos = offset;
             pw->current_pos = offset;
             pw->end_pos = offset + amount;
-            pw->rid[0] = rid[0];
-            pw->rid[1] = rid[1];
-            pw->rid[2] = rid[2];
-            strncpy(pw->addr, addr, sizeof(pw->addr) - 1);
-            pw->addr[sizeof(pw->addr) - 1] = '\0';
-            pw->port = port;
+            pw->chunk = (uint32_t)cfg->server.write_chunk;
+            pw->window = cfg->server.write_window;
+
+            // Cached details go stale once data arrives; forgotten again
+            // when the transfer completes and when the file is closed
+            ras_attrcache_invalidate(h->path);
             
-            // Request first chunk of data
+            // Request first window of data
             // Positions sent to client are relative to start_pos
-            uint32_t chunk = (amount < WRITE_CHUNK_SIZE) ? amount : WRITE_CHUNK_SIZE;
-            send_w_pkt(net, rid, 0, chunk, addr, port);
+            request_write_window(net, pw);
+            ras_transfers_sent(transfers, pw);
             break;
         }
 
@@ -1003,7 +1382,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 break;
             }
             
-            send_readdir_response(net, rid, h->path, cfg, hid, start_entry, addr, port);
+            h->dir_next = send_readdir_response(net, rid, dir_listing(cfg, h), start_entry, addr, port);
             break;
         }
 
@@ -1023,10 +1402,12 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 send_err_pkt(net, rid, EBADF, addr, port);
                 break;
             }
-            if (ftruncate(h->fd, (off_t)new_len) != 0) {
+            if (ras_fileio_flush(h) != 0 || ftruncate(h->fd, (off_t)new_len) != 0) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
             }
+            ras_fileio_invalidate(h);
+            object_changed(h->path, NULL);
             // Reply with the new length
             unsigned char reply[4];
             write_u32(reply, new_len);
@@ -1051,6 +1432,13 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             // Update handle's stored load/exec addresses
             h->load_addr = load_addr;
             h->exec_addr = exec_addr;
+
+            // Shares keeping RISC OS details in extended attributes need
+            // no rename, and untyped load/exec addresses are kept too
+            int stored = store_handle_info(h) == 0;
+            if (stored) {
+                object_changed(h->path, NULL);
+            }
             
             // Extract filetype and rename file with ,xxx suffix (files only, not directories)
             uint32_t new_ftype = 0;
@@ -1058,17 +1446,22 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 new_ftype = (load_addr >> 8) & 0xFFF;
                 
                 // Only rename files, not directories (directories don't need ,xxx suffix)
-                if (h->path[0] && h->type == RAS_HANDLE_FILE) {
+                if (!stored && h->path && h->path[0] && h->type == RAS_HANDLE_FILE) {
                     char new_path[512];
                     ras_append_type_suffix(h->path, new_ftype, new_path, sizeof(new_path));
-                    if (strcmp(h->path, new_path) != 0) {
-                        if (rename(h->path, new_path) == 0) {
-                            // Update handle's stored path
-                            strncpy(h->path, new_path, sizeof(h->path) - 1);
-                            h->path[sizeof(h->path) - 1] = '\0';
-                            ras_log(RAS_LOG_DEBUG, "RSETINFO: renamed to '%s'", new_path);
-                        }
+                    char *renamed = strcmp(h->path, new_path) != 0 ? (char *)malloc(strlen(new_path) + 1) : NULL;
+                    if (renamed && rename(h->path, new_path) == 0) {
+                        object_changed(new_path, NULL);
+                        object_changed(h->path, NULL);
+                        ras_pathcache_forget_host(h->path);
+                        // Update handle's stored path
+                        strcpy(renamed, new_path);
+                        free(h->path);
+                        h->path = renamed;
+                        renamed = NULL;
+                        ras_log(RAS_LOG_DEBUG, "RSETINFO: renamed to '%s'", new_path);
                     }
+                    free(renamed);
                 }
                 
                 // Update file mtime from timestamp
@@ -1080,17 +1473,24 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                     struct utimbuf ut;
                     ut.actime = unix_time;
                     ut.modtime = unix_time;
-                    if (h->path[0]) {
+                    if (h->path && h->path[0]) {
                         utime(h->path, &ut);
+                        object_changed(h->path, NULL);
                     }
                 }
             }
             
             // Return FileDesc
             struct stat st;
-            if (h->path[0] && stat(h->path, &st) == 0) {
+            if (h->path && h->path[0] && ras_hostfs_stat(h->path, &st) == 0) {
                 unsigned char reply[20];
-                build_filedesc(reply, &st, new_ftype);
+                if (stored) {
+                    ras_xattr_info info = { load_addr, exec_addr, h->attrs };
+                    merge_host_details(&st, &info);
+                    build_filedesc_info(reply, &st, &info);
+                } else {
+                    build_filedesc(reply, &st, new_ftype);
+                }
                 send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
             } else {
                 // Can't stat, just acknowledge
@@ -1146,7 +1546,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             
             // Get current size
             struct stat st;
-            if (fstat(h->fd, &st) != 0) {
+            if (ras_fileio_flush(h) != 0 || fstat(h->fd, &st) != 0) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
             }
@@ -1157,6 +1557,8 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                     send_err_pkt(net, rid, errno, addr, port);
                     break;
                 }
+                ras_fileio_invalidate(h);
+                object_changed(h->path, NULL);
             }
             
             // Reply with the length
@@ -1181,14 +1583,8 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 break;
             }
             
-            off_t pos = lseek(h->fd, 0, SEEK_CUR);
-            if (pos < 0) {
-                send_err_pkt(net, rid, errno, addr, port);
-                break;
-            }
-            
             unsigned char reply[4];
-            write_u32(reply, (uint32_t)pos);
+            write_u32(reply, h->seq_ptr);
             send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
             break;
         }
@@ -1210,14 +1606,11 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 break;
             }
             
-            off_t pos = lseek(h->fd, (off_t)new_pos, SEEK_SET);
-            if (pos < 0) {
-                send_err_pkt(net, rid, errno, addr, port);
-                break;
-            }
+            // Tracked per handle; data transfers always use explicit offsets
+            h->seq_ptr = new_pos;
             
             unsigned char reply[4];
-            write_u32(reply, (uint32_t)pos);
+            write_u32(reply, new_pos);
             send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
             break;
         }
@@ -1243,11 +1636,17 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             // Seek to offset and extend file with zeros
             uint32_t new_length = offset + zero_len;
             struct stat st;
+            if (ras_fileio_flush(h) != 0) {
+                send_err_pkt(net, rid, errno, addr, port);
+                break;
+            }
             if (fstat(h->fd, &st) == 0 && (off_t)new_length > st.st_size) {
                 if (ftruncate(h->fd, (off_t)new_length) != 0) {
                     send_err_pkt(net, rid, errno, addr, port);
                     break;
                 }
+                ras_fileio_invalidate(h);
+                object_changed(h->path, NULL);
             }
             
             // Reply with the new length
@@ -1282,19 +1681,15 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         switch (code) {
         case 0x03: // ROPENDIR
         {
-            ras_log(RAS_LOG_DEBUG, "ROPENDIR: attempting resolve_path for '%s'", path);
-            if (resolve_path(cfg, path, host_path, sizeof(host_path)) != 0) {
-                ras_log(RAS_LOG_DEBUG, "ROPENDIR: resolve_path failed, trying share match");
+            ras_log(RAS_LOG_DEBUG, "ROPENDIR: looking up '%s'", path);
+            struct stat st;
+            int found = find_host_path(cfg, path, host_path, sizeof(host_path), &st) == 0;
+            if (!found) {
+                ras_log(RAS_LOG_DEBUG, "ROPENDIR: path not found, trying share match");
                 // Path is a share name - check if it's a valid share
-                int share_idx = -1;
-                for (size_t i = 0; i < cfg->share_count; ++i) {
-                    if (strcasecmp(cfg->shares[i].name, path) == 0) {
-                        share_idx = (int)i;
-                        break;
-                    }
-                }
-                if (share_idx >= 0) {
-                    snprintf(host_path, sizeof(host_path), "%s", cfg->shares[share_idx].path);
+                const ras_share_config *share = ras_config_find_share(cfg, path, strlen(path));
+                if (share) {
+                    snprintf(host_path, sizeof(host_path), "%s", share->path);
                     ras_log(RAS_LOG_DEBUG, "ROPENDIR: share match found, path='%s'", host_path);
                 } else {
                     ras_log(RAS_LOG_DEBUG, "ROPENDIR: no share match, sending ENOENT");
@@ -1303,8 +1698,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 }
             }
             ras_log(RAS_LOG_DEBUG, "ROPENDIR: host_path='%s'", host_path);
-            struct stat st;
-            if (stat(host_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            if ((!found && ras_hostfs_stat(host_path, &st) != 0) || !S_ISDIR(st.st_mode)) {
                 ras_log(RAS_LOG_DEBUG, "ROPENDIR: stat failed or not a dir: errno=%d", errno);
                 send_err_pkt(net, rid, ENOTDIR, addr, port);
                 break;
@@ -1319,8 +1713,10 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                 break;
             }
             ras_log(RAS_LOG_DEBUG, "ROPENDIR: handle=%d, calling send_catalogue_response", hid);
+            ras_handle *h = open_dir_handle(handles, hid);
             // Send combined S+B catalogue response
-            send_catalogue_response(net, rid, host_path, cfg, hid, addr, port);
+            size_t next = send_catalogue_response(net, rid, dir_listing(cfg, h), hid, addr, port);
+            if (h) h->dir_next = next;
             break;
         }
 
@@ -1333,33 +1729,18 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             uint32_t rlen = read_u32(buf + 16);
             
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->fd < 0) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             
             if (pos == 0xFFFFFFFF) {
-                // Sequential read: get current position
-                off_t current = lseek(h->fd, 0, SEEK_CUR);
-                if (current < 0) {
-                     send_err_pkt(net, rid, errno, addr, port);
-                     break;
-                }
-                pos = (uint32_t)current;
-            } else {
-                if (lseek(h->fd, (off_t)pos, SEEK_SET) < 0) {
-                    send_err_pkt(net, rid, errno, addr, port);
-                    break;
-                }
+                // Sequential read: continue from the handle's pointer
+                pos = h->seq_ptr;
             }
             
             // Limit read size
             if (rlen > 16384) rlen = 16384;
             unsigned char data[16384];
-            ssize_t n = read(h->fd, data, rlen);
+            ssize_t n = ras_fileio_read(h, data, rlen, pos);
             if (n < 0) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
@@ -1391,7 +1772,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             write_u32(pkt + off, (uint32_t)n); off += 4;
             write_u32(pkt + off, new_pos); off += 4;
             
-            ras_net_sendto(net->rpc, pkt, off, addr, port);
+            ras_net_reply(net, pkt, off, addr, port);
             free(pkt);
             break;
         }
@@ -1406,18 +1787,22 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             int hid = (int)handle;
 
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->type != RAS_HANDLE_DIR || !h->path) {
                 send_err_pkt(net, rid, EBADF, addr, port);
                 break;
             }
-            // Send combined S+B readdir response
-            send_readdir_response(net, rid, h->path, cfg, hid, 0, addr, port);
+            // This form carries no entry index. A new request carries on
+            // from the previous page, or starts over once the listing has
+            // been sent in full; a retransmit gets the same page again
+            // even if the reply cache no longer holds it.
+            const ras_dir_snapshot *snap = dir_listing(cfg, h);
+            uint32_t rid_key = ((uint32_t)rid[0] | ((uint32_t)rid[1] << 8) | ((uint32_t)rid[2] << 16)) + 1;
+            if (h->dir_rid != rid_key) {
+                h->dir_page = snap && h->dir_next < snap->count ? h->dir_next : 0;
+                h->dir_rid = rid_key;
+            }
+            h->dir_next = send_readdir_response(net, rid, snap, h->dir_page, addr, port);
             break;
         }
 
@@ -1445,15 +1830,15 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         case 0x0a: // RCLOSE
         {
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h) { send_err_pkt(net, rid, EBADF, addr, port); break; }
+            int err = ras_fileio_flush(h) != 0 ? errno : 0;
+            if (h->written) {
+                object_changed(h->path, NULL);
+            }
             if (h->fd >= 0) close(h->fd);
             ras_handles_close(handles, hid, h->token);
+            if (err != 0) { send_err_pkt(net, rid, err, addr, port); break; }
             send_r_pkt(net, rid, NULL, 0, addr, port);
             break;
         }
@@ -1467,63 +1852,10 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             ras_log(RAS_LOG_DEBUG, "A-cmd RREAD: handle=%d offset=%u len=%u", hid, off, rlen);
 
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->fd < 0) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             
-            // Allocate pending read
-            pending_read_t *pr = alloc_pending_read();
-            if (!pr) {
-                send_err_pkt(net, rid, EMFILE, addr, port);
-                break;
-            }
-            
-            pr->handle_id = hid;
-            pr->start_pos = off;
-            pr->current_pos = off;
-            pr->end_pos = off + rlen;
-            pr->state = RAS_READ_STATE_WAIT_DATA_ACK;
-            pr->rid[0] = rid[0];
-            pr->rid[1] = rid[1];
-            pr->rid[2] = rid[2];
-            strncpy(pr->addr, addr, sizeof(pr->addr) - 1);
-            pr->addr[sizeof(pr->addr) - 1] = '\0';
-            pr->port = port;
-            
-            // Send first chunk
-            uint32_t amount = (rlen < READ_CHUNK_SIZE) ? rlen : READ_CHUNK_SIZE;
-            
-            if (lseek(h->fd, (off_t)pr->current_pos, SEEK_SET) < 0) {
-                free_pending_read(pr);
-                send_err_pkt(net, rid, errno, addr, port);
-                break;
-            }
-            
-            unsigned char data[READ_CHUNK_SIZE];
-            ssize_t n = read(h->fd, data, amount);
-            if (n < 0) {
-                free_pending_read(pr);
-                send_err_pkt(net, rid, errno, addr, port);
-                break;
-            }
-            
-            // Send D packet with offset relative to start (should be 0 for first chunk)
-            send_d_pkt_with_offset(net, rid, pr->current_pos - pr->start_pos, data, (size_t)n, addr, port);
-            
-            pr->current_pos += (uint32_t)n;
-            
-            // If completed immediately (small file), send R packet too
-            if (pr->current_pos >= pr->end_pos) {
-                 unsigned char reply[8];
-                 write_u32(reply, pr->end_pos - pr->start_pos);
-                 write_u32(reply + 4, pr->end_pos);
-                 send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
-                 free_pending_read(pr);
-            }
+            start_read(cfg, net, transfers, h, hid, rid, off, rlen, addr, port);
             break;
         }
 
@@ -1536,12 +1868,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             ras_log(RAS_LOG_DEBUG, "a-cmd RWRITE: handle=%d offset=%u amount=%u", hid, off, amount);
             
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->fd < 0) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             
             // If amount is 0, nothing to do
@@ -1551,7 +1878,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             }
             
             // Allocate pending write state
-            pending_write_t *pw = alloc_pending_write();
+            ras_transfer *pw = ras_transfers_add(transfers, RAS_TRANSFER_WRITE, rid, addr, port);
             if (!pw) {
                 send_err_pkt(net, rid, ENOMEM, addr, port);
                 break;
@@ -1561,16 +1888,17 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             pw->start_pos = off;
             pw->current_pos = off;
             pw->end_pos = off + amount;
-            pw->rid[0] = rid[0];
-            pw->rid[1] = rid[1];
-            pw->rid[2] = rid[2];
-            strncpy(pw->addr, addr, sizeof(pw->addr) - 1);
-            pw->addr[sizeof(pw->addr) - 1] = '\0';
-            pw->port = port;
+            pw->chunk = (uint32_t)cfg->server.write_chunk;
+            pw->window = cfg->server.write_window;
+
+            // Cached details go stale once data arrives; forgotten again
+            // when the transfer completes and when the file is closed
+            ras_attrcache_invalidate(h->path);
             
-            // Request first chunk of data
-            uint32_t chunk = (amount < WRITE_CHUNK_SIZE) ? amount : WRITE_CHUNK_SIZE;
-            send_w_pkt(net, rid, 0, chunk, addr, port);
+            // Request first window of data
+            // Positions sent to client are relative to start_pos
+            request_write_window(net, pw);
+            ras_transfers_sent(transfers, pw);
             break;
         }
 
@@ -1579,17 +1907,12 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             if (len < 16) { send_err_pkt(net, rid, EINVAL, addr, port); break; }
             unsigned int start = read_u32(buf + 12);
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->type != RAS_HANDLE_DIR || !h->path) {
                 send_err_pkt(net, rid, EBADF, addr, port);
                 break;
             }
-            send_readdir_response(net, rid, h->path, cfg, hid, start, addr, port);
+            h->dir_next = send_readdir_response(net, rid, dir_listing(cfg, h), start, addr, port);
             break;
         }
 
@@ -1598,16 +1921,11 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             if (len < 16) { send_err_pkt(net, rid, EINVAL, addr, port); break; }
             unsigned int ensure_size = read_u32(buf + 12);
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->fd < 0) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             
             struct stat st;
-            if (fstat(h->fd, &st) != 0) {
+            if (ras_fileio_flush(h) != 0 || fstat(h->fd, &st) != 0) {
                 send_err_pkt(net, rid, errno, addr, port);
                 break;
             }
@@ -1616,6 +1934,8 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
                     send_err_pkt(net, rid, errno, addr, port);
                     break;
                 }
+                ras_fileio_invalidate(h);
+                object_changed(h->path, NULL);
             }
             unsigned char reply[4];
             write_u32(reply, ensure_size);
@@ -1628,14 +1948,11 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             if (len < 16) { send_err_pkt(net, rid, EINVAL, addr, port); break; }
             unsigned int newlen = read_u32(buf + 12);
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->fd < 0) { send_err_pkt(net, rid, EBADF, addr, port); break; }
-            if (ftruncate(h->fd, (off_t)newlen) != 0) { send_err_pkt(net, rid, errno, addr, port); break; }
+            if (ras_fileio_flush(h) != 0 || ftruncate(h->fd, (off_t)newlen) != 0) { send_err_pkt(net, rid, errno, addr, port); break; }
+            ras_fileio_invalidate(h);
+            object_changed(h->path, NULL);
             h->length = newlen;
             send_r_pkt(net, rid, NULL, 0, addr, port);
             break;
@@ -1647,20 +1964,21 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             uint32_t load = read_u32(buf + 12);
             uint32_t exec = read_u32(buf + 16);
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             h->load_addr = load;
             h->exec_addr = exec;
-            // Update file mtime from exec address
-            if (h->path) {
+            int stored = store_handle_info(h) == 0;
+            if (stored) {
+                object_changed(h->path, NULL);
+            }
+            // Update file mtime from exec address, unless that is a
+            // stored untyped address rather than a date
+            if (h->path && (!stored || (load & 0xFFF00000u) == 0xFFF00000u)) {
                 uint64_t cs = ((uint64_t)(load & 0xFF) << 32) | exec;
                 time_t t = ras_time_from_riscos(cs);
                 ras_set_mtime(h->path, t);
+                object_changed(h->path, NULL);
             }
             send_r_pkt(net, rid, NULL, 0, addr, port);
             break;
@@ -1669,12 +1987,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         case 0x11: // RGETSEQPTR
         {
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             unsigned char reply[4];
             write_u32(reply, h->seq_ptr);
@@ -1687,15 +2000,9 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             if (len < 16) { send_err_pkt(net, rid, EINVAL, addr, port); break; }
             uint32_t ptr = read_u32(buf + 12);
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             h->seq_ptr = ptr;
-            if (h->fd >= 0) lseek(h->fd, (off_t)ptr, SEEK_SET);
             send_r_pkt(net, rid, NULL, 0, addr, port);
             break;
         }
@@ -1706,21 +2013,22 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
             unsigned int offset = read_u32(buf + 12);
             unsigned int zero_len = read_u32(buf + 16);
             ras_handle *h = NULL;
-            for (size_t i = 0; i < handles->count; ++i) {
-                if (handles->items[i].id == hid) {
-                    h = &handles->items[i];
-                    break;
-                }
-            }
+            ras_handles_get(handles, hid, &h);
             if (!h || h->fd < 0) { send_err_pkt(net, rid, EBADF, addr, port); break; }
             
             uint32_t new_length = offset + zero_len;
             struct stat st;
+            if (ras_fileio_flush(h) != 0) {
+                send_err_pkt(net, rid, errno, addr, port);
+                break;
+            }
             if (fstat(h->fd, &st) == 0 && (off_t)new_length > st.st_size) {
                 if (ftruncate(h->fd, (off_t)new_length) != 0) {
                     send_err_pkt(net, rid, errno, addr, port);
                     break;
                 }
+                ras_fileio_invalidate(h);
+                object_changed(h->path, NULL);
             }
             unsigned char reply[4];
             write_u32(reply, new_length);
@@ -1799,7 +2107,7 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         ras_log(RAS_LOG_DEBUG, "d-pkt: rel_pos=%u data_len=%zu", rel_pos, data_len);
         
         // Find pending write for this reply ID
-        pending_write_t *pw = find_pending_write(rid);
+        ras_transfer *pw = ras_transfers_find(transfers, RAS_TRANSFER_WRITE, rid, addr, port);
         if (!pw) {
             ras_log(RAS_LOG_DEBUG, "d-pkt: no pending write found for rid");
             return 0;
@@ -1809,67 +2117,84 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
         ras_handle *h = NULL;
         if (ras_handles_get(handles, pw->handle_id, &h) != 0 || !h || h->fd < 0) {
             ras_log(RAS_LOG_DEBUG, "d-pkt: handle %d invalid", pw->handle_id);
-            free_pending_write(pw);
+            ras_transfers_remove(transfers, pw);
             return 0;
         }
         
-        // Check for sequential write
+        // Nothing past the length the client declared is written or held
+        uint32_t span = pw->end_pos - pw->start_pos;
+        if (rel_pos >= span) {
+            ras_log(RAS_LOG_DEBUG, "d-pkt: rel_pos=%u beyond end %u", rel_pos, span);
+            return 0;
+        }
+        if (data_len > span - rel_pos) data_len = span - rel_pos;
+
         uint32_t expected_rel = pw->current_pos - pw->start_pos;
-        if (rel_pos != expected_rel) {
-            ras_log(RAS_LOG_ERROR, "d-pkt: Non-sequential write. rel_pos=%u expected=%u", rel_pos, expected_rel);
-            
-            // If gap detected, re-request the expected chunk immediately
-            if (rel_pos > expected_rel) {
-                uint32_t remaining = pw->end_pos - pw->current_pos;
-                uint32_t chunk = (remaining < WRITE_CHUNK_SIZE) ? remaining : WRITE_CHUNK_SIZE;
-                send_w_pkt(net, pw->rid, expected_rel, expected_rel + chunk, pw->addr, pw->port);
-            }
+        if (rel_pos < expected_rel && rel_pos + data_len > expected_rel) {
+            // Overlaps data we already have: keep only the new tail
+            data += expected_rel - rel_pos;
+            data_len -= expected_rel - rel_pos;
+            rel_pos = expected_rel;
+        }
+        if (rel_pos < expected_rel || data_len == 0) {
+            ras_log(RAS_LOG_DEBUG, "d-pkt: duplicate rel_pos=%u expected=%u", rel_pos, expected_rel);
             return 0;
         }
+        if (rel_pos > expected_rel) {
+            // Arrived ahead of a hole: hold it until the hole is filled. If it
+            // does not fit the reorder budget it is requested again later.
+            uint32_t abs_pos = pw->start_pos + rel_pos;
+            if (ras_transfers_stash(transfers, pw, abs_pos, data, data_len) == 0) {
+                ras_log(RAS_LOG_DEBUG, "d-pkt: held rel_pos=%u, waiting for %u", rel_pos, expected_rel);
+                pw->reordered++;
+            }
+            ras_transfers_waiting(transfers, pw);
 
-        // Calculate absolute position and write data
-        uint32_t abs_pos = pw->start_pos + rel_pos;
-        if (lseek(h->fd, (off_t)abs_pos, SEEK_SET) < 0) {
-            ras_log(RAS_LOG_DEBUG, "d-pkt: lseek failed");
-            send_err_pkt(net, pw->rid, errno, pw->addr, pw->port);
-            free_pending_write(pw);
+            // Several packets past the hole: assume it was lost, not reordered
+            if (pw->reordered >= WRITE_REORDER_THRESHOLD && !pw->hole_requested) {
+                pw->hole_requested = 1;
+                request_write_holes(net, pw, 1);
+            }
             return 0;
         }
-        
-        ssize_t n = write(h->fd, data, data_len);
-        if (n < 0) {
+
+        // In order: write it together with any held data that now follows
+        // on, gathered into a single positional write
+        if (write_in_order(handles, h, pw, data, data_len) != 0) {
             ras_log(RAS_LOG_DEBUG, "d-pkt: write failed");
             send_err_pkt(net, pw->rid, errno, pw->addr, pw->port);
-            free_pending_write(pw);
+            ras_transfers_remove(transfers, pw);
             return 0;
         }
-        
-        pw->current_pos = abs_pos + (uint32_t)n;
+
+        pw->hole_requested = 0;
+        pw->reordered = 0;
+        ras_transfers_acked(transfers, pw);
         h->seq_ptr = pw->current_pos;
         if (h->seq_ptr > h->length) h->length = h->seq_ptr;
         
-        ras_log(RAS_LOG_DEBUG, "d-pkt: wrote %zd bytes at %u, current_pos=%u end_pos=%u", 
-                n, abs_pos, pw->current_pos, pw->end_pos);
+        ras_log(RAS_LOG_DEBUG, "d-pkt: wrote up to %u, end_pos=%u", pw->current_pos, pw->end_pos);
         
         // Check if we need more data
-        if (pw->current_pos < pw->end_pos) {
-            // Request next chunk
-            uint32_t rel_current = pw->current_pos - pw->start_pos;
-            uint32_t remaining = pw->end_pos - pw->current_pos;
-            uint32_t chunk = (remaining < WRITE_CHUNK_SIZE) ? remaining : WRITE_CHUNK_SIZE;
-            send_w_pkt(net, pw->rid, rel_current, rel_current + chunk, pw->addr, pw->port);
+        if (pw->current_pos < pw->last_pos + pw->last_len) {
+            // Rest of the window is still on its way
+            ras_transfers_waiting(transfers, pw);
+        } else if (pw->current_pos < pw->end_pos) {
+            request_write_window(net, pw);
+            ras_transfers_sent(transfers, pw);
         } else {
             // Transfer complete
             ras_log(RAS_LOG_DEBUG, "d-pkt: transfer complete, sending R-pkt");
+            ras_attrcache_invalidate(h->path);
             send_r_pkt(net, pw->rid, NULL, 0, pw->addr, pw->port);
-            free_pending_write(pw);
+            ras_transfers_remove(transfers, pw);
         }
         return 0;
     }
 
     // 'r' command - acknowledgement packet from client for RREAD
     if (cmd == 'r') {
-        return ras_rpc_handle_r(buf, len, addr, port, net, handles);
+        return ras_rpc_handle_r(buf, len, addr, port, net, handles, transfers);
     }
 
     // Unknown command
@@ -1878,9 +2203,57 @@ int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsig
     return 0;
 }
 
+// Requests answered by a fixed set of R/S/B/E datagrams. RREAD and RWRITE
+// start transfers, which deal with retransmits themselves.
+static int reply_cacheable(unsigned char cmd, uint32_t code) {
+    if (cmd == 'A' || cmd == 'a') return code != 0x0b && code != 0x0c;
+    return cmd == 'B' || cmd == 'F';
+}
+
+// Resend a cached reply, one datagram at a time
+static void replay_reply(ras_net *net, const ras_reply_entry *e, const char *addr, unsigned short port) {
+    size_t off = 0;
+    while (off + 2 <= e->len) {
+        size_t n = (size_t)e->data[off] | ((size_t)e->data[off + 1] << 8);
+        off += 2;
+        if (off + n > e->len) break;
+        ras_net_reply(net, e->data + off, n, addr, port);
+        off += n;
+    }
+}
+
+int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsigned short port,
+                   const ras_config *cfg, ras_net *net, ras_handle_table *handles,
+                   ras_transfer_table *transfers, ras_reply_cache *replies, ras_auth_state *auth) {
+    if (!buf || len < 4 || !net || !cfg || !handles) return -1;
+
+    unsigned char cmd = buf[0];
+    uint32_t code = len >= 8 ? read_u32(buf + 4) : 0;
+    if (!ras_replycache_enabled(replies) || len < 8 || !reply_cacheable(cmd, code)) {
+        return dispatch_rpc(buf, len, addr, port, cfg, net, handles, transfers, auth);
+    }
+
+    const ras_reply_entry *hit = ras_replycache_find(replies, cmd, buf + 1, code, addr, port, buf, len);
+    if (hit) {
+        ras_log(RAS_LOG_DEBUG, "Retransmitted %c-cmd code=%u from %s:%u answered from reply cache",
+                cmd, code, addr, port);
+        replay_reply(net, hit, addr, port);
+        return 0;
+    }
+
+    ras_net_capture capture = { replies->scratch, RAS_REPLYCACHE_MAX_REPLY, 0, 0 };
+    ras_net_begin_capture(net, &capture);
+    int rc = dispatch_rpc(buf, len, addr, port, cfg, net, handles, transfers, auth);
+    ras_net_end_capture(net);
+    if (!capture.overflow) {
+        ras_replycache_store(replies, cmd, buf + 1, code, addr, port, buf, len, capture.data, capture.used);
+    }
+    return rc;
+}
+
 // Handle 'r' packet (acknowledgement from client for RREAD data)
 int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, unsigned short port,
-                     ras_net *net, ras_handle_table *handles) {
+                     ras_net *net, ras_handle_table *handles, ras_transfer_table *transfers) {
     // Format: r + rid(3) + ...
     if (len < 4) return 0;
     
@@ -1888,7 +2261,7 @@ int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, uns
     // Low level protocol logging only
     // ras_log(RAS_LOG_DEBUG, "r-pkt from %s:%u", addr, port);
     
-    pending_read_t *pr = find_pending_read(rid);
+    ras_transfer *pr = ras_transfers_find(transfers, RAS_TRANSFER_READ, rid, addr, port);
     if (!pr) {
         // Can happen if we resent R or client is delayed
         return 0;
@@ -1897,12 +2270,29 @@ int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, uns
     ras_handle *h = NULL;
     if (ras_handles_get(handles, pr->handle_id, &h) != 0 || !h || h->fd < 0) {
         ras_log(RAS_LOG_DEBUG, "r-pkt: handle %d invalid", pr->handle_id);
-        free_pending_read(pr);
+        ras_transfers_remove(transfers, pr);
+        return 0;
+    }
+
+    if (pr->state == RAS_READ_STATE_WAIT_DATA_ACK && len >= 12 && pr->last_pos > pr->start_pos &&
+        pr->start_pos + read_u32(buf + 4) == pr->last_pos) {
+        // Repeat of the status ack that asked for the chunk in flight; the
+        // retransmit timer covers the chunk if it was lost
         return 0;
     }
+    if (pr->state == RAS_READ_STATE_WAIT_STATUS_ACK && len < 12) {
+        // Repeat of a data ack after a retransmitted chunk
+        return 0;
+    }
+    ras_transfers_acked(transfers, pr);
 
     if (pr->state == RAS_READ_STATE_WAIT_DATA_ACK) {
-        // We received ACK for the data packet.
+        // Each D packet of the window is acked separately
+        if (++pr->acked < pr->burst) {
+            ras_transfers_waiting(transfers, pr);
+            return 0;
+        }
+
         ras_log(RAS_LOG_DEBUG, "RREAD: Done Data %u/%u. Sending Status.", pr->current_pos - pr->start_pos, pr->end_pos - pr->start_pos);
         
         // Send Status Packet (D header with current offset, no data)
@@ -1910,15 +2300,13 @@ int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, uns
         
         if (pr->current_pos >= pr->end_pos) {
             ras_log(RAS_LOG_DEBUG, "RREAD: Transfer Complete. Sending R.");
-            // Transfer complete
-            unsigned char reply[8];
-            write_u32(reply, pr->end_pos - pr->start_pos);
-            write_u32(reply + 4, pr->end_pos);
-            send_r_pkt(net, rid, reply, sizeof(reply), addr, port);
-            free_pending_read(pr);
+            h->seq_ptr = pr->end_pos;
+            send_read_done(net, pr);
+            ras_transfers_remove(transfers, pr);
         } else {
-            // Wait for client to request next chunk
+            // Wait for client to request next range
            pr->state = RAS_READ_STATE_WAIT_STATUS_ACK;
+           ras_transfers_sent(transfers, pr);
         }
     }
     else if (pr->state == RAS_READ_STATE_WAIT_STATUS_ACK) {
@@ -1927,7 +2315,7 @@ int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, uns
         // Format: r + rid + pos(4) + end(4) (relative to start)
         if (len < 12) {
             ras_log(RAS_LOG_DEBUG, "r-pkt: short status ack");
-            free_pending_read(pr);
+            ras_transfers_remove(transfers, pr);
             return 0;
         }
         
@@ -1937,45 +2325,78 @@ int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, uns
         ras_log(RAS_LOG_DEBUG, "RREAD: Client Request: RelPos=%u RelEnd=%u", rel_pos, rel_end);
         
         uint32_t next_pos = pr->start_pos + rel_pos;
-        uint32_t chunk_end = pr->start_pos + rel_end;
+        uint32_t range_end = pr->start_pos + rel_end;
         
         // Sanity check
         if (next_pos >= pr->end_pos) {
              ras_log(RAS_LOG_DEBUG, "RREAD: Client requested beyond end.");
-             free_pending_read(pr);
+             ras_transfers_remove(transfers, pr);
              return 0;
         }
+        if (range_end <= next_pos) range_end = next_pos + pr->chunk;
         
-        // Update current position to what client asked for
+        // Stream as much of the requested range as the window allows
         pr->current_pos = next_pos;
-        
-        // Determine chunk size
-        uint32_t amount = chunk_end - next_pos;
-        if (amount > READ_CHUNK_SIZE) amount = READ_CHUNK_SIZE;
-        // Also cap at total file end
-        if (pr->current_pos + amount > pr->end_pos) amount = pr->end_pos - pr->current_pos;
-        
-        ras_log(RAS_LOG_DEBUG, "RREAD: Sending Data: Offset=%u Len=%u", pr->current_pos - pr->start_pos, amount);
-        
-        // Read next chunk
-        if (lseek(h->fd, (off_t)pr->current_pos, SEEK_SET) < 0) {
-            free_pending_read(pr);
-            return 0;
-        }
-        
-        unsigned char data[READ_CHUNK_SIZE];
-        ssize_t n = read(h->fd, data, amount);
-        if (n < 0) {
-             free_pending_read(pr);
+        if (send_read_window(net, pr, h, range_end) != 0) {
+             ras_transfers_remove(transfers, pr);
              return 0;
         }
-        
-        // Send Data Packet
-        send_d_pkt_with_offset(net, rid, pr->current_pos - pr->start_pos, data, (size_t)n, addr, port);
-        
-        pr->current_pos += (uint32_t)n;
-        pr->state = RAS_READ_STATE_WAIT_DATA_ACK;
+        ras_log(RAS_LOG_DEBUG, "RREAD: Sent Data: Offset=%u Len=%u in %d packets",
+                pr->last_pos - pr->start_pos, pr->last_len, pr->burst);
+        ras_transfers_sent(transfers, pr);
     }
     
     return 0;
 }
+
+typedef struct {
+    ras_net *net;
+    ras_handle_table *handles;
+    ras_transfer_table *transfers;
+} expire_ctx;
+
+// Resend the last D/w packet of a stalled transfer, rebuilt from its
+// state, or reap it once the client has been silent for the idle limit
+static void expire_transfer(ras_transfer *x, uint64_t now, void *arg) {
+    expire_ctx *c = (expire_ctx *)arg;
+    ras_transfer_table *transfers = c->transfers;
+
+    ras_handle *h = NULL;
+    if (ras_handles_get(c->handles, x->handle_id, &h) != 0 || !h || h->fd < 0) {
+        ras_log(RAS_LOG_DEBUG, "transfer: handle %d gone, dropping", x->handle_id);
+        ras_transfers_remove(transfers, x);
+        return;
+    }
+    if (transfers->idle_ms > 0 && now - x->active_ms >= transfers->idle_ms) {
+        ras_log(RAS_LOG_INFO, "transfer: %s from %s:%u idle, dropping",
+                x->kind == RAS_TRANSFER_READ ? "read" : "write", x->addr, x->port);
+        ras_transfers_remove(transfers, x);
+        return;
+    }
+
+    ras_transfers_backoff(x);
+    if (x->kind == RAS_TRANSFER_WRITE) {
+        // Ask again for whatever is missing from the current window
+        ras_log(RAS_LOG_DEBUG, "RWRITE: retransmit holes from %u (try %d)", x->current_pos - x->start_pos, x->retries);
+        request_write_holes(c->net, x, WRITE_MAX_HOLES);
+    } else if (x->state == RAS_READ_STATE_WAIT_STATUS_ACK) {
+        ras_log(RAS_LOG_DEBUG, "RREAD: retransmit status (try %d)", x->retries);
+        send_d_pkt_with_offset(c->net, x->rid, x->current_pos - x->start_pos, NULL, 0, x->addr, x->port);
+    } else {
+        // Acks carry no position, so resend the whole window; the client's
+        // next status ack says where it really got to
+        ras_log(RAS_LOG_DEBUG, "RREAD: retransmit %d packets (try %d)", x->burst, x->retries);
+        x->acked = 0;
+        if (send_read_data(c->net, x, h, x->last_pos, x->last_pos + x->last_len, x->burst) != 0) {
+            ras_transfers_remove(transfers, x);
+            return;
+        }
+    }
+    ras_transfers_sent(transfers, x);
+}
+
+void ras_rpc_expire_transfers(ras_net *net, ras_handle_table *handles, ras_transfer_table *transfers) {
+    if (!net || !handles || !transfers) return;
+    expire_ctx c = { net, handles, transfers };
+    ras_transfers_expire(transfers, ras_monotonic_ms(), expire_transfer, &c);
+}
@@ -9,11 +9,18 @@
 #include "net.h"
 #include "config.h"
 #include "accessplus.h"
+#include "transfer.h"
+#include "replycache.h"
 
 int ras_rpc_handle(const unsigned char *buf, size_t len, const char *addr, unsigned short port,
-                   const ras_config *cfg, ras_net *net, ras_handle_table *handles, ras_auth_state *auth);
+                   const ras_config *cfg, ras_net *net, ras_handle_table *handles,
+                   ras_transfer_table *transfers, ras_reply_cache *replies, ras_auth_state *auth);
 
 int ras_rpc_handle_r(const unsigned char *buf, size_t len, const char *addr, unsigned short port,
-                     ras_net *net, ras_handle_table *handles);
+                     ras_net *net, ras_handle_table *handles, ras_transfer_table *transfers);
+
+// Retransmit stalled transfers and reap idle ones; call every
+// RAS_TRANSFER_TICK_MS while any transfer is in flight
+void ras_rpc_expire_transfers(ras_net *net, ras_handle_table *handles, ras_transfer_table *transfers);
 
 #endif
@@ -0,0 +1,161 @@
+// RISC OS Access/ShareFS Server - Path Resolution Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "pathcache.h"
+#include "platform.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Direct-mapped: a path has one slot and a newer path sharing it
+// replaces the older, so lookup and store are a single probe
+typedef struct {
+    uint32_t hash;
+    int state;              // RAS_PATHCACHE_FOUND or _MISSING
+    char *key;              // Case-folded RISC OS path, NULL while empty
+    char *host;             // Host path found, or the directory lacking it
+    ras_dir_stamp stamp;    // Of that directory, for missing entries
+    int64_t seen_sec;
+} path_entry;
+
+static ras_mutex g_lock;
+static path_entry *g_slots = NULL;
+static size_t g_slot_count = 0;  // Power of two, 0 when disabled
+
+static uint32_t hash_folded(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (uint32_t)tolower((unsigned char)*s);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int folded_equal(const char *key, const char *s) {
+    for (; *key && *s; ++key, ++s) {
+        if (*key != (char)tolower((unsigned char)*s)) return 0;
+    }
+    return *key == '\0' && *s == '\0';
+}
+
+static char *fold_dup(const char *s) {
+    size_t len = strlen(s);
+    char *out = (char *)malloc(len + 1);
+    if (!out) return NULL;
+    for (size_t i = 0; i <= len; ++i) out[i] = (char)tolower((unsigned char)s[i]);
+    return out;
+}
+
+static void clear_entry(path_entry *e) {
+    free(e->key);
+    free(e->host);
+    memset(e, 0, sizeof(*e));
+}
+
+int ras_pathcache_init(const ras_config *cfg) {
+    ras_mutex_init(&g_lock);
+    size_t want = cfg && cfg->server.path_cache_entries > 0 ? (size_t)cfg->server.path_cache_entries : 0;
+    if (want == 0) return 0;
+    size_t count = 16;
+    while (count < want) count *= 2;
+    g_slots = (path_entry *)calloc(count, sizeof(path_entry));
+    if (!g_slots) return -1;
+    g_slot_count = count;
+    return 0;
+}
+
+void ras_pathcache_shutdown(void) {
+    for (size_t i = 0; i < g_slot_count; ++i) clear_entry(&g_slots[i]);
+    free(g_slots);
+    g_slots = NULL;
+    g_slot_count = 0;
+    ras_mutex_destroy(&g_lock);
+}
+
+int ras_pathcache_find(const char *ro_path, char *host, size_t host_sz) {
+    if (g_slot_count == 0 || !ro_path) return RAS_PATHCACHE_UNKNOWN;
+    uint32_t hash = hash_folded(ro_path);
+
+    ras_mutex_lock(&g_lock);
+    path_entry *e = &g_slots[hash & (g_slot_count - 1)];
+    if (!e->key || e->hash != hash || !folded_equal(e->key, ro_path)) {
+        ras_mutex_unlock(&g_lock);
+        return RAS_PATHCACHE_UNKNOWN;
+    }
+    int state = e->state;
+    char dir[512];
+    ras_dir_stamp seen = e->stamp;
+    int64_t seen_sec = e->seen_sec;
+    size_t len = strlen(e->host);
+    if (len >= host_sz || len >= sizeof(dir)) {
+        ras_mutex_unlock(&g_lock);
+        return RAS_PATHCACHE_UNKNOWN;
+    }
+    memcpy(state == RAS_PATHCACHE_FOUND ? host : dir, e->host, len + 1);
+    ras_mutex_unlock(&g_lock);
+    if (state == RAS_PATHCACHE_FOUND) return state;
+
+    // Missing only while the directory that lacked the name is unchanged
+    ras_dir_stamp now;
+    if (ras_dircache_read_stamp(dir, &now) == 0 && ras_dircache_stamp_current(&seen, seen_sec, &now)) {
+        return RAS_PATHCACHE_MISSING;
+    }
+    ras_pathcache_forget(ro_path);
+    return RAS_PATHCACHE_UNKNOWN;
+}
+
+static void store(const char *ro_path, int state, const char *host,
+                  const ras_dir_stamp *stamp, int64_t seen_sec) {
+    if (g_slot_count == 0 || !ro_path || !host) return;
+    uint32_t hash = hash_folded(ro_path);
+    char *key = fold_dup(ro_path);
+    size_t host_len = strlen(host);
+    char *host_copy = (char *)malloc(host_len + 1);
+    if (!key || !host_copy) {
+        free(key);
+        free(host_copy);
+        return;
+    }
+    memcpy(host_copy, host, host_len + 1);
+
+    ras_mutex_lock(&g_lock);
+    path_entry *e = &g_slots[hash & (g_slot_count - 1)];
+    clear_entry(e);
+    e->hash = hash;
+    e->state = state;
+    e->key = key;
+    e->host = host_copy;
+    if (stamp) e->stamp = *stamp;
+    e->seen_sec = seen_sec;
+    ras_mutex_unlock(&g_lock);
+}
+
+void ras_pathcache_store_found(const char *ro_path, const char *host) {
+    store(ro_path, RAS_PATHCACHE_FOUND, host, NULL, 0);
+}
+
+void ras_pathcache_store_missing(const char *ro_path, const char *dir,
+                                 const ras_dir_stamp *stamp, int64_t seen_sec) {
+    store(ro_path, RAS_PATHCACHE_MISSING, dir, stamp, seen_sec);
+}
+
+void ras_pathcache_forget_host(const char *host) {
+    if (g_slot_count == 0 || !host) return;
+    ras_mutex_lock(&g_lock);
+    for (size_t i = 0; i < g_slot_count; ++i) {
+        path_entry *e = &g_slots[i];
+        if (e->key && e->state == RAS_PATHCACHE_FOUND && strcmp(e->host, host) == 0) clear_entry(e);
+    }
+    ras_mutex_unlock(&g_lock);
+}
+
+void ras_pathcache_forget(const char *ro_path) {
+    if (g_slot_count == 0 || !ro_path) return;
+    uint32_t hash = hash_folded(ro_path);
+    ras_mutex_lock(&g_lock);
+    path_entry *e = &g_slots[hash & (g_slot_count - 1)];
+    if (e->key && e->hash == hash && folded_equal(e->key, ro_path)) clear_entry(e);
+    ras_mutex_unlock(&g_lock);
+}
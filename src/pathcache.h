@@ -0,0 +1,45 @@
+// RISC OS Access/ShareFS Server - Path Resolution Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_PATHCACHE_H
+#define RAS_PATHCACHE_H
+
+#include "config.h"
+#include "dircache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where a RISC OS path was last found on the host, matched without
+// regard to case or ,xxx suffix. A found entry holds until its host path
+// stops existing; a missing entry holds while the directory that lacked
+// the name is unchanged. Shared by all workers.
+int ras_pathcache_init(const ras_config *cfg);
+void ras_pathcache_shutdown(void);
+
+#define RAS_PATHCACHE_UNKNOWN (-1)
+#define RAS_PATHCACHE_MISSING 0
+#define RAS_PATHCACHE_FOUND   1
+
+// Look up a RISC OS path. On RAS_PATHCACHE_FOUND the host path is copied
+// to host; the caller confirms it still exists.
+int ras_pathcache_find(const char *ro_path, char *host, size_t host_sz);
+
+// Record the host path a RISC OS path resolved to
+void ras_pathcache_store_found(const char *ro_path, const char *host);
+
+// Record that a RISC OS path does not exist because directory dir, with
+// the given stamp when read at wall-clock second seen_sec, lacks it
+void ras_pathcache_store_missing(const char *ro_path, const char *dir,
+                                 const ras_dir_stamp *stamp, int64_t seen_sec);
+
+// Drop what is known about a RISC OS path
+void ras_pathcache_forget(const char *ro_path);
+
+// Drop every RISC OS path found at host, for a host object renamed
+// through a handle, which does not know the path it was opened by.
+// Scans the whole cache.
+void ras_pathcache_forget_host(const char *host);
+
+#endif
@@ -2,12 +2,18 @@
 // Author: Andrew Timmins
 // License: GPL-3.0-only
 
+#ifdef __linux__
+#define _GNU_SOURCE  // pwritev
+#endif
+
 #include "platform.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #include <winsock2.h>
 #include <direct.h>
+#include <io.h>
+#include <stdlib.h>
 #include <sys/utime.h>
 
 int ras_platform_init(void) {
@@ -23,6 +29,10 @@ void ras_sleep_ms(int ms) {
     Sleep((DWORD)ms);
 }
 
+uint64_t ras_monotonic_ms(void) {
+    return (uint64_t)GetTickCount64();
+}
+
 int ras_mkdir(const char *path) {
     if (!path) return -1;
     return _mkdir(path);
@@ -50,10 +60,94 @@ int ras_set_mtime(const char *path, time_t mtime) {
     return _utime(path, &ut);
 }
 
+ssize_t ras_pread(int fd, void *buf, size_t len, uint64_t offset) {
+    if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0) return -1;
+    return (ssize_t)_read(fd, buf, (unsigned int)len);
+}
+
+ssize_t ras_pwrite(int fd, const void *buf, size_t len, uint64_t offset) {
+    if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0) return -1;
+    return (ssize_t)_write(fd, buf, (unsigned int)len);
+}
+
+void ras_mutex_init(ras_mutex *m) {
+    InitializeCriticalSection(m);
+}
+
+void ras_mutex_destroy(ras_mutex *m) {
+    DeleteCriticalSection(m);
+}
+
+void ras_mutex_lock(ras_mutex *m) {
+    EnterCriticalSection(m);
+}
+
+void ras_mutex_unlock(ras_mutex *m) {
+    LeaveCriticalSection(m);
+}
+
+typedef struct {
+    ras_thread_fn fn;
+    void *arg;
+} thread_start;
+
+static DWORD WINAPI thread_main(LPVOID param) {
+    thread_start start = *(thread_start *)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+int ras_thread_create(ras_thread *t, ras_thread_fn fn, void *arg) {
+    thread_start *start = (thread_start *)malloc(sizeof(*start));
+    if (!start) return -1;
+    start->fn = fn;
+    start->arg = arg;
+    *t = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+    if (!*t) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void ras_thread_join(ras_thread t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+void ras_cond_init(ras_cond *c) {
+    InitializeConditionVariable(c);
+}
+
+void ras_cond_destroy(ras_cond *c) {
+    (void)c;  // Windows condition variables hold no resources
+}
+
+void ras_cond_wait(ras_cond *c, ras_mutex *m) {
+    SleepConditionVariableCS(c, m, INFINITE);
+}
+
+void ras_cond_broadcast(ras_cond *c) {
+    WakeAllConditionVariable(c);
+}
+
+ssize_t ras_pwritev(int fd, const ras_iovec *iov, int count, uint64_t offset) {
+    ssize_t total = 0;
+    for (int i = 0; i < count; ++i) {
+        ssize_t n = ras_pwrite(fd, iov[i].base, iov[i].len, offset + (uint64_t)total);
+        if (n < 0) return total > 0 ? total : -1;
+        total += n;
+        if ((size_t)n < iov[i].len) break;
+    }
+    return total;
+}
+
 #else
 #include <time.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/uio.h>
 #include <utime.h>
 
 int ras_platform_init(void) {
@@ -71,6 +165,12 @@ void ras_sleep_ms(int ms) {
     nanosleep(&ts, NULL);
 }
 
+uint64_t ras_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
 int ras_mkdir(const char *path) {
     if (!path) return -1;
     return mkdir(path, 0775);
@@ -98,4 +198,63 @@ int ras_set_mtime(const char *path, time_t mtime) {
     return utime(path, &ut);
 }
 
+ssize_t ras_pread(int fd, void *buf, size_t len, uint64_t offset) {
+    return pread(fd, buf, len, (off_t)offset);
+}
+
+ssize_t ras_pwrite(int fd, const void *buf, size_t len, uint64_t offset) {
+    return pwrite(fd, buf, len, (off_t)offset);
+}
+
+ssize_t ras_pwritev(int fd, const ras_iovec *iov, int count, uint64_t offset) {
+    if (count <= 0) return 0;
+    if (count > RAS_MAX_IOV) count = RAS_MAX_IOV;
+    struct iovec v[RAS_MAX_IOV];
+    for (int i = 0; i < count; ++i) {
+        v[i].iov_base = (void *)(uintptr_t)iov[i].base;
+        v[i].iov_len = iov[i].len;
+    }
+    return pwritev(fd, v, count, (off_t)offset);
+}
+
+void ras_mutex_init(ras_mutex *m) {
+    pthread_mutex_init(m, NULL);
+}
+
+void ras_mutex_destroy(ras_mutex *m) {
+    pthread_mutex_destroy(m);
+}
+
+void ras_mutex_lock(ras_mutex *m) {
+    pthread_mutex_lock(m);
+}
+
+void ras_mutex_unlock(ras_mutex *m) {
+    pthread_mutex_unlock(m);
+}
+
+int ras_thread_create(ras_thread *t, ras_thread_fn fn, void *arg) {
+    return pthread_create(t, NULL, fn, arg) == 0 ? 0 : -1;
+}
+
+void ras_thread_join(ras_thread t) {
+    pthread_join(t, NULL);
+}
+
+void ras_cond_init(ras_cond *c) {
+    pthread_cond_init(c, NULL);
+}
+
+void ras_cond_destroy(ras_cond *c) {
+    pthread_cond_destroy(c);
+}
+
+void ras_cond_wait(ras_cond *c, ras_mutex *m) {
+    pthread_cond_wait(c, m);
+}
+
+void ras_cond_broadcast(ras_cond *c) {
+    pthread_cond_broadcast(c);
+}
+
 #endif
@@ -13,9 +13,16 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
+#include <BaseTsd.h>
+typedef SSIZE_T ssize_t;
+
 typedef SOCKET ras_socket;
 #define RAS_INVALID_SOCKET INVALID_SOCKET
+typedef CRITICAL_SECTION ras_mutex;
+typedef HANDLE ras_thread;
+typedef CONDITION_VARIABLE ras_cond;
 #else
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -23,11 +30,38 @@ typedef SOCKET ras_socket;
 
 typedef int ras_socket;
 #define RAS_INVALID_SOCKET (-1)
+typedef pthread_mutex_t ras_mutex;
+typedef pthread_t ras_thread;
+typedef pthread_cond_t ras_cond;
+#endif
+
+// Per-thread storage for state owned by a single RPC worker
+#if defined(_MSC_VER)
+#define RAS_THREAD_LOCAL __declspec(thread)
+#else
+#define RAS_THREAD_LOCAL _Thread_local
 #endif
 
+// Lock for the few caches shared between RPC workers
+void ras_mutex_init(ras_mutex *m);
+void ras_mutex_destroy(ras_mutex *m);
+void ras_mutex_lock(ras_mutex *m);
+void ras_mutex_unlock(ras_mutex *m);
+
+// Threads for extra RPC workers and the stat pool
+typedef void *(*ras_thread_fn)(void *arg);
+int ras_thread_create(ras_thread *t, ras_thread_fn fn, void *arg);
+void ras_thread_join(ras_thread t);
+
+void ras_cond_init(ras_cond *c);
+void ras_cond_destroy(ras_cond *c);
+void ras_cond_wait(ras_cond *c, ras_mutex *m);
+void ras_cond_broadcast(ras_cond *c);
+
 int ras_platform_init(void);
 void ras_platform_shutdown(void);
 void ras_sleep_ms(int ms);
+uint64_t ras_monotonic_ms(void);
 int ras_mkdir(const char *path);
 
 // Cross-platform filesystem info
@@ -42,4 +76,20 @@ int ras_get_fsinfo(const char *path, ras_fsinfo *info);
 // Cross-platform utime
 int ras_set_mtime(const char *path, time_t mtime);
 
+// Positional file I/O that leaves the descriptor's offset alone, so
+// transfers sharing a handle cannot disturb each other. Windows falls
+// back to seek + read/write.
+#define RAS_MAX_IOV 16
+
+typedef struct {
+    const void *base;
+    size_t len;
+} ras_iovec;
+
+ssize_t ras_pread(int fd, void *buf, size_t len, uint64_t offset);
+ssize_t ras_pwrite(int fd, const void *buf, size_t len, uint64_t offset);
+
+// Gather write of up to RAS_MAX_IOV buffers in one call where supported
+ssize_t ras_pwritev(int fd, const ras_iovec *iov, int count, uint64_t offset);
+
 #endif
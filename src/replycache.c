@@ -0,0 +1,163 @@
+// RISC OS Access/ShareFS Server - Reply Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "replycache.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t fnv1a(uint32_t h, const unsigned char *p, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t hash_key(unsigned char cmd, const unsigned char *rid, uint32_t code,
+                       const char *addr, unsigned short port) {
+    uint32_t h = fnv1a(2166136261u, (const unsigned char *)addr, strlen(addr));
+    unsigned char tail[10] = { cmd, rid[0], rid[1], rid[2],
+                               (unsigned char)(port & 0xFF), (unsigned char)(port >> 8),
+                               (unsigned char)(code & 0xFF), (unsigned char)((code >> 8) & 0xFF),
+                               (unsigned char)((code >> 16) & 0xFF), (unsigned char)(code >> 24) };
+    return (size_t)fnv1a(h, tail, sizeof(tail));
+}
+
+static int key_matches(const ras_reply_entry *e, unsigned char cmd, const unsigned char *rid,
+                       uint32_t code, const char *addr, unsigned short port) {
+    return e->cmd == cmd && e->code == code && e->port == port &&
+           e->rid[0] == rid[0] && e->rid[1] == rid[1] && e->rid[2] == rid[2] &&
+           strcmp(e->addr, addr) == 0;
+}
+
+int ras_replycache_init(ras_reply_cache *c, size_t max_entries, size_t max_bytes, uint64_t ttl_ms) {
+    if (!c) return -1;
+    memset(c, 0, sizeof(*c));
+    c->max_entries = max_entries;
+    c->max_bytes = max_bytes;
+    c->ttl_ms = ttl_ms;
+    if (!ras_replycache_enabled(c)) return 0;
+
+    c->bucket_count = 16;
+    while (c->bucket_count < max_entries) c->bucket_count <<= 1;
+    c->buckets = (ras_reply_entry **)calloc(c->bucket_count, sizeof(ras_reply_entry *));
+    c->scratch = (unsigned char *)malloc(RAS_REPLYCACHE_MAX_REPLY);
+    if (!c->buckets || !c->scratch) {
+        ras_replycache_free(c);
+        return -1;
+    }
+    return 0;
+}
+
+int ras_replycache_enabled(const ras_reply_cache *c) {
+    return c && c->max_entries > 0 && c->max_bytes > 0 && c->ttl_ms > 0;
+}
+
+static void unlink_entry(ras_reply_cache *c, ras_reply_entry *e) {
+    ras_reply_entry **pp = &c->buckets[hash_key(e->cmd, e->rid, e->code, e->addr, e->port) & (c->bucket_count - 1)];
+    while (*pp && *pp != e) pp = &(*pp)->next;
+    if (*pp) *pp = e->next;
+
+    if (e->older) e->older->newer = e->newer; else c->oldest = e->newer;
+    if (e->newer) e->newer->older = e->older; else c->newest = e->older;
+
+    c->count -= 1;
+    c->bytes -= e->len + e->request_len;
+    free(e->data);
+    free(e);
+}
+
+void ras_replycache_free(ras_reply_cache *c) {
+    if (!c) return;
+    ras_reply_entry *e = c->oldest;
+    while (e) {
+        ras_reply_entry *newer = e->newer;
+        free(e->data);
+        free(e);
+        e = newer;
+    }
+    free(c->buckets);
+    free(c->scratch);
+    memset(c, 0, sizeof(*c));
+}
+
+// Drop entries past their TTL; the age list makes this a walk from the front
+static void expire(ras_reply_cache *c, uint64_t now) {
+    while (c->oldest && now - c->oldest->stored_ms > c->ttl_ms) {
+        unlink_entry(c, c->oldest);
+    }
+}
+
+const ras_reply_entry *ras_replycache_find(ras_reply_cache *c, unsigned char cmd, const unsigned char *rid,
+                                           uint32_t code, const char *addr, unsigned short port,
+                                           const unsigned char *req, size_t req_len) {
+    if (!ras_replycache_enabled(c) || !rid || !addr) return NULL;
+    expire(c, ras_monotonic_ms());
+
+    ras_reply_entry *e = c->buckets[hash_key(cmd, rid, code, addr, port) & (c->bucket_count - 1)];
+    for (; e; e = e->next) {
+        if (key_matches(e, cmd, rid, code, addr, port)) break;
+    }
+    if (e && e->request_len == req_len && e->request_hash == fnv1a(2166136261u, req, req_len) &&
+        memcmp(e->request, req, req_len) == 0) {
+        c->hits += 1;
+        return e;
+    }
+    c->misses += 1;
+    return NULL;
+}
+
+void ras_replycache_store(ras_reply_cache *c, unsigned char cmd, const unsigned char *rid,
+                          uint32_t code, const char *addr, unsigned short port,
+                          const unsigned char *req, size_t req_len,
+                          const unsigned char *data, size_t len) {
+    if (!ras_replycache_enabled(c) || !rid || !addr || !req || !data || len == 0) return;
+    size_t held = len + req_len;
+    if (held > c->max_bytes) return;
+
+    size_t b = hash_key(cmd, rid, code, addr, port) & (c->bucket_count - 1);
+    for (ras_reply_entry *e = c->buckets[b]; e; e = e->next) {
+        if (key_matches(e, cmd, rid, code, addr, port)) {
+            // The client reused the rid for a new request
+            unlink_entry(c, e);
+            break;
+        }
+    }
+
+    uint64_t now = ras_monotonic_ms();
+    expire(c, now);
+    while (c->oldest && (c->count >= c->max_entries || c->bytes + held > c->max_bytes)) {
+        unlink_entry(c, c->oldest);
+    }
+
+    ras_reply_entry *e = (ras_reply_entry *)calloc(1, sizeof(ras_reply_entry));
+    if (!e) return;
+    e->data = (unsigned char *)malloc(held);
+    if (!e->data) {
+        free(e);
+        return;
+    }
+    memcpy(e->data, data, len);
+    e->len = len;
+    memcpy(e->data + len, req, req_len);
+    e->request = e->data + len;
+    e->request_len = req_len;
+    e->stored_ms = now;
+    e->request_hash = fnv1a(2166136261u, req, req_len);
+    e->code = code;
+    e->cmd = cmd;
+    memcpy(e->rid, rid, 3);
+    e->port = port;
+    strncpy(e->addr, addr, sizeof(e->addr) - 1);
+
+    e->next = c->buckets[b];
+    c->buckets[b] = e;
+    e->older = c->newest;
+    if (c->newest) c->newest->newer = e; else c->oldest = e;
+    c->newest = e;
+    c->count += 1;
+    c->bytes += held;
+}
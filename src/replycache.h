@@ -0,0 +1,66 @@
+// RISC OS Access/ShareFS Server - Reply Cache
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_REPLYCACHE_H
+#define RAS_REPLYCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest reply (all datagrams for one request) worth keeping
+#define RAS_REPLYCACHE_MAX_REPLY 32768
+
+// Replies already sent for a client request, identified by the client's
+// address, port, reply ID and operation. A client retransmits a request
+// when its reply is lost; answering from here keeps the retry idempotent.
+typedef struct ras_reply_entry {
+    struct ras_reply_entry *next;   // Hash chain
+    struct ras_reply_entry *newer;  // Age list, oldest first
+    struct ras_reply_entry *older;
+    uint64_t stored_ms;
+    uint32_t request_hash;          // Quick check before comparing the request
+    uint32_t code;                  // Operation code
+    unsigned char cmd;              // Request command letter
+    unsigned char rid[3];
+    unsigned short port;
+    char addr[64];
+    size_t len;
+    unsigned char *data;            // Datagrams in ras_net_capture format
+    const unsigned char *request;   // Request datagram, stored after data;
+    size_t request_len;             // tells a real retransmit from rid reuse
+} ras_reply_entry;
+
+typedef struct {
+    ras_reply_entry **buckets;
+    size_t bucket_count;            // Power of two
+    ras_reply_entry *oldest;
+    ras_reply_entry *newest;
+    size_t count;
+    size_t bytes;                   // Reply and request bytes held
+    size_t max_entries;
+    size_t max_bytes;
+    uint64_t ttl_ms;                // Replies older than this are not replayed
+    uint64_t hits;
+    uint64_t misses;
+    unsigned char *scratch;         // RAS_REPLYCACHE_MAX_REPLY bytes to record a reply in
+} ras_reply_cache;
+
+// max_entries or ttl_ms of 0 disables the cache
+int ras_replycache_init(ras_reply_cache *c, size_t max_entries, size_t max_bytes, uint64_t ttl_ms);
+void ras_replycache_free(ras_reply_cache *c);
+int ras_replycache_enabled(const ras_reply_cache *c);
+
+// Reply previously sent for this exact request, or NULL. Counts a hit or miss.
+const ras_reply_entry *ras_replycache_find(ras_reply_cache *c, unsigned char cmd, const unsigned char *rid,
+                                           uint32_t code, const char *addr, unsigned short port,
+                                           const unsigned char *req, size_t req_len);
+
+// Remember the reply sent for a request, evicting the oldest entries to
+// stay within budget
+void ras_replycache_store(ras_reply_cache *c, unsigned char cmd, const unsigned char *rid,
+                          uint32_t code, const char *addr, unsigned short port,
+                          const unsigned char *req, size_t req_len,
+                          const unsigned char *data, size_t len);
+
+#endif
@@ -39,6 +39,75 @@ static const struct { const char *ext; uint32_t type; } builtin_map[] = {
     { NULL, 0 }
 };
 
+// FNV-1a, fed one lowercase character at a time
+#define TYPE_HASH_SEED 2166136261u
+
+static inline uint32_t type_hash_step(uint32_t h, char c) {
+    return (h ^ (unsigned char)c) * 16777619u;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static const ras_type_slot *find_type(const ras_config *cfg, const char *ext, size_t len, uint32_t hash) {
+    size_t mask = cfg->type_index_size - 1;
+    for (size_t slot = hash & mask; cfg->type_index[slot].len != 0; slot = (slot + 1) & mask) {
+        const ras_type_slot *t = &cfg->type_index[slot];
+        if (t->hash == hash && t->len == len && memcmp(t->ext, ext, len) == 0) return t;
+    }
+    return NULL;
+}
+
+// First definition of an extension wins, so add mimemap entries first
+static void add_type(ras_config *cfg, const char *ext, uint32_t type) {
+    char lower[RAS_TYPE_EXT_MAX];
+    uint32_t hash = TYPE_HASH_SEED;
+    size_t len = 0;
+    for (; ext[len]; ++len) {
+        if (len == sizeof(lower) - 1) return;  // Never matched
+        lower[len] = (char)tolower((unsigned char)ext[len]);
+        hash = type_hash_step(hash, lower[len]);
+    }
+    if (len == 0 || find_type(cfg, lower, len, hash)) return;
+
+    size_t mask = cfg->type_index_size - 1;
+    size_t slot = hash & mask;
+    while (cfg->type_index[slot].len != 0) slot = (slot + 1) & mask;
+    ras_type_slot *t = &cfg->type_index[slot];
+    t->hash = hash;
+    t->type = type & 0xFFF;
+    t->len = len;
+    memcpy(t->ext, lower, len);
+    t->ext[len] = '\0';
+}
+
+int ras_filetype_index_build(ras_config *cfg) {
+    if (!cfg) return -1;
+    size_t count = cfg->mimemap_count + sizeof(builtin_map) / sizeof(builtin_map[0]);
+    size_t size = 64;
+    while (size < count * 2) size *= 2;
+    free(cfg->type_index);
+    cfg->type_index = (ras_type_slot *)calloc(size, sizeof(ras_type_slot));
+    if (!cfg->type_index) {
+        cfg->type_index_size = 0;
+        return -1;
+    }
+    cfg->type_index_size = size;
+
+    for (size_t j = 0; j < cfg->mimemap_count; ++j) {
+        const ras_mime_entry *m = &cfg->mimemap[j];
+        if (m->ext && m->filetype) add_type(cfg, m->ext, (uint32_t)strtoul(m->filetype, NULL, 16));
+    }
+    for (int j = 0; builtin_map[j].ext; ++j) {
+        add_type(cfg, builtin_map[j].ext, builtin_map[j].type);
+    }
+    return 0;
+}
+
 uint32_t ras_filetype_from_ext(const char *filename, const ras_config *cfg) {
     if (!filename) return RAS_FILETYPE_DATA;
 
@@ -49,33 +118,21 @@ uint32_t ras_filetype_from_ext(const char *filename, const ras_config *cfg) {
     }
 
     const char *dot = strrchr(filename, '.');
-    if (!dot || dot == filename) return RAS_FILETYPE_DATA;
+    if (!dot || dot == filename || !cfg || cfg->type_index_size == 0) return RAS_FILETYPE_DATA;
     dot++;
 
-    char ext_lower[16];
-    size_t i;
-    for (i = 0; i < sizeof(ext_lower) - 1 && dot[i]; ++i) {
-        ext_lower[i] = (char)tolower((unsigned char)dot[i]);
-    }
-    ext_lower[i] = '\0';
-
-    // Check config mimemap first
-    if (cfg) {
-        for (size_t j = 0; j < cfg->mimemap_count; ++j) {
-            if (cfg->mimemap[j].ext && strcmp(cfg->mimemap[j].ext, ext_lower) == 0) {
-                return (uint32_t)strtoul(cfg->mimemap[j].filetype, NULL, 16);
-            }
-        }
+    // Fold and hash in one pass; no known extension is this long
+    char ext_lower[RAS_TYPE_EXT_MAX];
+    uint32_t hash = TYPE_HASH_SEED;
+    size_t len = 0;
+    for (; dot[len]; ++len) {
+        if (len == sizeof(ext_lower) - 1) return RAS_FILETYPE_DATA;
+        ext_lower[len] = (char)tolower((unsigned char)dot[len]);
+        hash = type_hash_step(hash, ext_lower[len]);
     }
 
-    // Check builtin map
-    for (int j = 0; builtin_map[j].ext; ++j) {
-        if (strcmp(builtin_map[j].ext, ext_lower) == 0) {
-            return builtin_map[j].type;
-        }
-    }
-
-    return RAS_FILETYPE_DATA;
+    const ras_type_slot *t = find_type(cfg, ext_lower, len, hash);
+    return t ? t->type : RAS_FILETYPE_DATA;
 }
 
 int ras_filetype_from_suffix(const char *filename) {
@@ -88,16 +145,11 @@ int ras_filetype_from_suffix(const char *filename) {
     const char *suffix = filename + len - 4;
     if (suffix[0] != ',') return -1;
     
-    // Check for 3 hex digits
-    for (int i = 1; i <= 3; i++) {
-        char c = (char)tolower((unsigned char)suffix[i]);
-        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
-            return -1;
-        }
-    }
-    
-    // Parse the hex value
-    return (int)strtol(suffix + 1, NULL, 16);
+    int d1 = hex_digit(suffix[1]);
+    int d2 = hex_digit(suffix[2]);
+    int d3 = hex_digit(suffix[3]);
+    if (d1 < 0 || d2 < 0 || d3 < 0) return -1;
+    return (d1 << 8) | (d2 << 4) | d3;
 }
 
 void ras_strip_type_suffix(const char *filename, char *out_buf, size_t out_sz) {
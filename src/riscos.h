@@ -70,9 +70,13 @@ static inline uint32_t ras_mode_to_attrs(unsigned int mode) {
     return attrs;
 }
 
-// Filetype from extension (basic mapping)
+// Filetype from extension, via the table built when the config is loaded
 uint32_t ras_filetype_from_ext(const char *filename, const ras_config *cfg);
 
+// Index [mimemap] and the built-in extensions into cfg->type_index;
+// mimemap entries take priority
+int ras_filetype_index_build(ras_config *cfg);
+
 // Extract filetype from ,xxx suffix (returns -1 if not present)
 // e.g., "myfile,fff" returns 0xFFF
 int ras_filetype_from_suffix(const char *filename);
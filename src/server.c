@@ -8,13 +8,16 @@
 #include "printer.h"
 #include "ops.h"
 #include "accessplus.h"
+#include "event.h"
+#include "fileio.h"
+#include "dircache.h"
+#include "hostfs.h"
+#include "statpool.h"
+#include "pathcache.h"
+#include "attrcache.h"
 
+#include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <errno.h>
-#ifndef _WIN32
-#include <sys/select.h>
-#endif
 #include <sys/stat.h>
 
 // Send RDEADHANDLES broadcast to all clients
@@ -51,13 +54,330 @@ static void broadcast_dead_handles(ras_handle_table *handles, ras_net *net) {
     ras_handles_clear_dead(handles);
 }
 
+// Per-worker state. Each worker owns its RPC/Access+ sockets, handle table,
+// auth entries and transfer registry, so no locks are needed.
+// Worker 0 runs on the calling thread and also owns broadcasts and printers.
+typedef struct {
+    int index;
+    ras_config *cfg;
+    ras_net *net;
+    ras_handle_table *handles;
+    ras_auth_state auth;
+    ras_transfer_table transfers;
+    ras_reply_cache replies;
+    ras_event_loop loop;
+    int transfer_timer;    // Runs only while transfers are in flight
+    int flush_timer;       // Runs only while handles hold write-behind data
+    ras_net_msg *rx;       // Receive batch buffers (NULL when unbatched)
+    size_t rx_max;
+    ras_net_txq *txq;      // Replies queued during a receive batch
+    ras_net own_net;       // Sockets of workers other than worker 0
+    ras_handle_table own_handles;
+    int loop_ready;
+#ifdef __linux__
+    ras_thread thread;
+    int started;
+#endif
+} ras_worker;
+
+// Tick the transfer timer wheel only while something is in flight
+static void sync_transfer_timer(ras_worker *w) {
+    int armed = ras_event_timer_armed(&w->loop, w->transfer_timer);
+    if (w->transfers.count > 0 && !armed) {
+        ras_event_arm_timer(&w->loop, w->transfer_timer, RAS_TRANSFER_TICK_MS, RAS_TRANSFER_TICK_MS);
+    } else if (w->transfers.count == 0 && armed) {
+        ras_event_arm_timer(&w->loop, w->transfer_timer, 0, 0);
+    }
+}
+
+// Armed when a handle starts buffering writes, so nothing waits longer
+// than RAS_FILEIO_FLUSH_MS to reach the file
+static void sync_flush_timer(ras_worker *w) {
+    if (w->handles->write_behind && !ras_event_timer_armed(&w->loop, w->flush_timer)) {
+        ras_event_arm_timer(&w->loop, w->flush_timer, RAS_FILEIO_FLUSH_MS, 0);
+    }
+}
+
+static void on_rpc_readable(ras_socket s, void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+
+    if (w->rx) {
+        // Drain what is pending in one syscall and flush all replies together
+        int count = ras_net_recv_batch(s, w->rx, w->rx_max);
+        if (count <= 0) return;
+        ras_net_begin_batch(w->net, w->txq);
+        for (int i = 0; i < count; ++i) {
+            ras_net_msg *m = &w->rx[i];
+            if (m->len == 0) continue;
+            ras_log(RAS_LOG_PROTOCOL, "RPC %zu bytes from %s:%u (worker %d)", m->len, m->addr, m->port, w->index);
+            ras_rpc_handle(m->buf, m->len, m->addr, m->port, w->cfg, w->net, w->handles, &w->transfers, &w->replies, &w->auth);
+        }
+        ras_net_end_batch(w->net);
+        sync_transfer_timer(w);
+        sync_flush_timer(w);
+        return;
+    }
+
+    unsigned char buf[RAS_NET_RX_MAX];
+    char addr[64];
+    unsigned short port = 0;
+    ssize_t n = ras_net_recvfrom(s, buf, sizeof(buf), addr, sizeof(addr), &port);
+    if (n > 0) {
+        ras_log(RAS_LOG_PROTOCOL, "RPC %zd bytes from %s:%u (worker %d)", n, addr, port, w->index);
+        ras_rpc_handle(buf, (size_t)n, addr, port, w->cfg, w->net, w->handles, &w->transfers, &w->replies, &w->auth);
+        sync_transfer_timer(w);
+        sync_flush_timer(w);
+    }
+}
+
+static void on_auth_readable(ras_socket s, void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+    unsigned char buf[1024];
+    char addr[64];
+    unsigned short port = 0;
+    ssize_t n = ras_net_recvfrom(s, buf, sizeof(buf), addr, sizeof(addr), &port);
+    if (n > 0) {
+        ras_log(RAS_LOG_PROTOCOL, "Auth %zd bytes from %s:%u (worker %d)", n, addr, port, w->index);
+        ras_accessplus_handle(buf, (size_t)n, addr, port, w->cfg, w->net, &w->auth);
+    }
+}
+
+static void on_freeway_readable(ras_socket s, void *ctx) {
+    (void)ctx;
+    unsigned char buf[1024];
+    char addr[64];
+    unsigned short port = 0;
+    ssize_t n = ras_net_recvfrom(s, buf, sizeof(buf), addr, sizeof(addr), &port);
+    if (n > 0) {
+        ras_log(RAS_LOG_PROTOCOL, "Freeway %zd bytes from %s:%u", n, addr, port);
+        // Could process client announcements here
+    }
+}
+
+static void on_broadcast_timer(void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+    ras_broadcast_shares(w->cfg, w->net);
+    ras_broadcast_printers(w->cfg, w->net);
+}
+
+static void on_dead_handles_timer(void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+    broadcast_dead_handles(w->handles, w->net);
+}
+
+static void on_transfer_timer(void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+    if (w->txq) ras_net_begin_batch(w->net, w->txq);
+    ras_rpc_expire_transfers(w->net, w->handles, &w->transfers);
+    if (w->txq) ras_net_end_batch(w->net);
+    sync_transfer_timer(w);
+}
+
+static void on_flush_timer(void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+    ras_fileio_flush_idle(w->handles, 0);
+    sync_flush_timer(w);
+}
+
+static void on_printer_timer(void *ctx) {
+    ras_worker *w = (ras_worker *)ctx;
+    ras_printers_poll(w->cfg);
+}
+
+static int gcd_int(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Printer spools are checked at the GCD of their poll intervals so that every
+// printer is serviced on time without waking up more often than needed
+static int printer_tick_seconds(const ras_config *cfg) {
+    int tick = 0;
+    for (size_t i = 0; i < cfg->printer_count; ++i) {
+        int interval = cfg->printers[i].poll_interval > 0 ? cfg->printers[i].poll_interval : 5;
+        tick = tick ? gcd_int(tick, interval) : interval;
+    }
+    return tick;
+}
+
+static int add_periodic_timer(ras_event_loop *loop, ras_event_timer_fn fn, void *ctx, uint64_t interval_ms) {
+    int id = ras_event_add_timer(loop, fn, ctx);
+    if (id < 0) return -1;
+    return ras_event_arm_timer(loop, id, interval_ms, interval_ms);
+}
+
+static int worker_setup(ras_worker *w) {
+    ras_config *cfg = w->cfg;
+    ras_net *net = w->net;
+
+    ras_auth_init(&w->auth);
+    if (ras_transfers_init(&w->transfers, (size_t)cfg->server.max_transfers,
+                           (uint64_t)cfg->server.transfer_timeout * 1000u,
+                           (size_t)cfg->server.write_reorder_bytes) != 0) {
+        ras_log(RAS_LOG_ERROR, "transfer registry init failed");
+        return -1;
+    }
+    if (ras_replycache_init(&w->replies, (size_t)cfg->server.reply_cache_entries,
+                            (size_t)cfg->server.reply_cache_bytes,
+                            (uint64_t)cfg->server.reply_cache_ttl * 1000u) != 0) {
+        ras_log(RAS_LOG_ERROR, "reply cache init failed");
+        return -1;
+    }
+    if (ras_event_init(&w->loop) != 0) {
+        ras_log(RAS_LOG_ERROR, "event loop init failed");
+        return -1;
+    }
+    w->loop_ready = 1;
+
+    // Batched receive/send buffers for the RPC socket
+    if (cfg->server.rpc_batch > 1) {
+        w->rx_max = (size_t)cfg->server.rpc_batch;
+        if (w->rx_max > RAS_NET_MAX_BATCH) w->rx_max = RAS_NET_MAX_BATCH;
+        w->rx = (ras_net_msg *)calloc(w->rx_max, sizeof(ras_net_msg));
+        w->txq = (ras_net_txq *)calloc(1, sizeof(ras_net_txq));
+        if (!w->rx || !w->txq) {
+            free(w->rx);
+            free(w->txq);
+            w->rx = NULL;
+            w->txq = NULL;
+            ras_log(RAS_LOG_ERROR, "RPC batch buffers unavailable, using unbatched I/O");
+        }
+    }
+
+    int rc = ras_event_add_fd(&w->loop, net->rpc, on_rpc_readable, w);
+
+    w->transfer_timer = ras_event_add_timer(&w->loop, on_transfer_timer, w);
+    if (w->transfer_timer < 0) rc = -1;
+    w->flush_timer = ras_event_add_timer(&w->loop, on_flush_timer, w);
+    if (w->flush_timer < 0) rc = -1;
+
+    // Also listen on auth port for Access+ if enabled
+    if (rc == 0 && cfg->server.access_plus && net->auth != RAS_INVALID_SOCKET) {
+        rc = ras_event_add_fd(&w->loop, net->auth, on_auth_readable, w);
+    }
+
+    // Every worker announces its own dead handles
+    if (rc == 0 && cfg->server.broadcast_interval > 0) {
+        rc = add_periodic_timer(&w->loop, on_dead_handles_timer, w,
+                                (uint64_t)cfg->server.broadcast_interval * 1000u);
+    }
+
+    if (w->index == 0) {
+        // Also listen on freeway port for announcements
+        if (rc == 0 && net->freeway != RAS_INVALID_SOCKET) {
+            rc = ras_event_add_fd(&w->loop, net->freeway, on_freeway_readable, w);
+        }
+
+        if (rc == 0 && cfg->server.broadcast_interval > 0) {
+            rc = add_periodic_timer(&w->loop, on_broadcast_timer, w,
+                                    (uint64_t)cfg->server.broadcast_interval * 1000u);
+        }
+
+        int printer_tick = printer_tick_seconds(cfg);
+        if (rc == 0 && printer_tick > 0) {
+            rc = add_periodic_timer(&w->loop, on_printer_timer, w, (uint64_t)printer_tick * 1000u);
+        }
+    }
+
+    if (rc != 0) {
+        ras_log(RAS_LOG_ERROR, "event loop setup failed for worker %d", w->index);
+        return -1;
+    }
+    return 0;
+}
+
+static void worker_cleanup(ras_worker *w) {
+    if (w->loop_ready) ras_event_free(&w->loop);
+    w->loop_ready = 0;
+    ras_transfers_free(&w->transfers);
+    if (ras_replycache_enabled(&w->replies)) {
+        ras_log(RAS_LOG_INFO, "worker %d reply cache: %llu hits, %llu misses", w->index,
+                (unsigned long long)w->replies.hits, (unsigned long long)w->replies.misses);
+    }
+    ras_replycache_free(&w->replies);
+    free(w->rx);
+    free(w->txq);
+    w->rx = NULL;
+    w->txq = NULL;
+    if (w->index > 0) {
+        ras_handles_free(&w->own_handles);
+        ras_net_close(&w->own_net);
+    }
+}
+
+#ifdef __linux__
+static void *worker_main(void *arg) {
+    ras_worker *w = (ras_worker *)arg;
+    ras_event_run(&w->loop);
+    return NULL;
+}
+#endif
+
+// Open sockets for workers 1..n-1 and steer clients across the group.
+// Returns the number of workers that can actually be used.
+static int open_workers(ras_worker *workers, int n, ras_config *cfg, ras_net *net) {
+    int opened = 1;
+    for (int i = 1; i < n; ++i) {
+        if (ras_net_open_worker(&workers[i].own_net, cfg->server.bind_ip) != 0) {
+            ras_log(RAS_LOG_ERROR, "worker %d: failed to open SO_REUSEPORT sockets", i);
+            break;
+        }
+        opened++;
+    }
+
+    if (opened == n && ras_net_attach_steering(net, (unsigned int)n) == 0) {
+        return n;
+    }
+    if (opened == n) {
+        ras_log(RAS_LOG_ERROR, "client steering unavailable");
+    }
+
+    // Without stable steering a client could hop between workers and lose
+    // its handles, so fall back to a single worker
+    for (int i = 1; i < opened; ++i) {
+        ras_net_close(&workers[i].own_net);
+    }
+    ras_log(RAS_LOG_ERROR, "running with a single worker");
+    return 1;
+}
+
+#ifdef __linux__
+// Start threads for workers 1..n-1. If one cannot start, its socket
+// would still be given its share of clients with nobody reading it, so
+// stop the others and fall back to a single worker. Returns the number
+// of workers running.
+static int start_workers(ras_worker *workers, int n, ras_net *net) {
+    int i = 1;
+    for (; i < n; ++i) {
+        if (ras_thread_create(&workers[i].thread, worker_main, &workers[i]) != 0) {
+            ras_log(RAS_LOG_ERROR, "failed to start worker %d", i);
+            break;
+        }
+        workers[i].started = 1;
+    }
+    if (i == n) return n;
+
+    for (i = 1; i < n; ++i) {
+        if (workers[i].started) {
+            ras_event_stop(&workers[i].loop);
+            ras_thread_join(workers[i].thread);
+            workers[i].started = 0;
+        }
+        worker_cleanup(&workers[i]);
+    }
+    ras_net_attach_steering(net, 1);
+    ras_log(RAS_LOG_ERROR, "running with a single worker");
+    return 1;
+}
+#endif
+
 int ras_server_run(ras_config *cfg, ras_net *net, ras_handle_table *handles) {
     if (!cfg || !net || !handles) return -1;
 
-    // Initialize auth state for tracking authenticated clients
-    ras_auth_state auth;
-    ras_auth_init(&auth);
-
     // Validate share/printer paths
     for (size_t i = 0; i < cfg->share_count; ++i) {
         struct stat st;
@@ -76,89 +396,89 @@ int ras_server_run(ras_config *cfg, ras_net *net, ras_handle_table *handles) {
 
     // Prepare printer spool dirs and definition files
     ras_printers_setup(cfg);
+    ras_fileio_init(cfg);
+    if (ras_hostfs_init(cfg) != 0) {
+        ras_log(RAS_LOG_ERROR, "share directories could not be opened");
+    }
+    if (ras_statpool_init(cfg) != 0) {
+        ras_log(RAS_LOG_ERROR, "stat pool unavailable, listing directories serially");
+    }
+    if (ras_dircache_init(cfg) != 0) {
+        ras_log(RAS_LOG_ERROR, "directory cache unavailable");
+    }
+    if (ras_pathcache_init(cfg) != 0) {
+        ras_log(RAS_LOG_ERROR, "path cache unavailable");
+    }
+    if (ras_attrcache_init(cfg) != 0) {
+        ras_log(RAS_LOG_ERROR, "attribute cache unavailable");
+    }
 
-    // Initial broadcasts
-    ras_broadcast_shares(cfg, net);
-    ras_broadcast_printers(cfg, net);
+    int n = cfg->server.workers > 1 ? cfg->server.workers : 1;
+#ifndef __linux__
+    if (n > 1) {
+        ras_log(RAS_LOG_ERROR, "workers = %d needs Linux, running with a single worker", n);
+        n = 1;
+    }
+#endif
 
-    time_t last_bcast = time(NULL);
+    ras_worker *workers = (ras_worker *)calloc((size_t)n, sizeof(ras_worker));
+    if (!workers) return -1;
 
-    ras_log(RAS_LOG_INFO, "Server running, %zu shares, %zu printers",
-            cfg->share_count, cfg->printer_count);
+    if (n > 1) {
+        n = open_workers(workers, n, cfg, net);
+    }
 
-    // Main loop
-    for (;;) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(net->rpc, &fds);
-        ras_socket maxfd = net->rpc;
+    for (int i = 0; i < n; ++i) {
+        workers[i].index = i;
+        workers[i].cfg = cfg;
+    }
 
-        // Also listen on auth port for Access+ if enabled
-        if (cfg->server.access_plus && net->auth != (ras_socket)-1) {
-            FD_SET(net->auth, &fds);
-            if (net->auth > maxfd) maxfd = net->auth;
+    int rc = 0;
+    for (int i = 0; i < n && rc == 0; ++i) {
+        ras_worker *w = &workers[i];
+        if (i == 0) {
+            w->net = net;
+            w->handles = handles;
+        } else {
+            w->net = &w->own_net;
+            w->handles = &w->own_handles;
+            ras_handles_init(w->handles);
         }
+        ras_handles_set_worker(w->handles, i);
+        rc = worker_setup(w);
+    }
 
-        // Also listen on freeway port for announcements
-        if (net->freeway != (ras_socket)-1) {
-            FD_SET(net->freeway, &fds);
-            if (net->freeway > maxfd) maxfd = net->freeway;
-        }
+    if (rc == 0) {
+        // Initial broadcasts and spool check
+        ras_broadcast_shares(cfg, net);
+        ras_broadcast_printers(cfg, net);
+        ras_printers_poll(cfg);
 
-        struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-
-        int ready = select((int)(maxfd + 1), &fds, NULL, NULL, &tv);
-
-        if (ready > 0) {
-            // Handle RPC packets
-            if (FD_ISSET(net->rpc, &fds)) {
-                unsigned char buf[4096];
-                char addr[64];
-                unsigned short port = 0;
-                ssize_t n = ras_net_recvfrom(net->rpc, buf, sizeof(buf), addr, sizeof(addr), &port);
-                if (n > 0) {
-                    ras_log(RAS_LOG_PROTOCOL, "RPC %zd bytes from %s:%u", n, addr, port);
-                    ras_rpc_handle(buf, (size_t)n, addr, port, cfg, net, handles, &auth);
-                }
-            }
-
-            // Handle Access+ auth packets
-            if (cfg->server.access_plus && net->auth != (ras_socket)-1 && FD_ISSET(net->auth, &fds)) {
-                unsigned char buf[1024];
-                char addr[64];
-                unsigned short port = 0;
-                ssize_t n = ras_net_recvfrom(net->auth, buf, sizeof(buf), addr, sizeof(addr), &port);
-                if (n > 0) {
-                    ras_log(RAS_LOG_PROTOCOL, "Auth %zd bytes from %s:%u", n, addr, port);
-                    ras_accessplus_handle(buf, (size_t)n, addr, port, cfg, net, &auth);
-                }
-            }
-
-            // Handle Freeway packets (client announcements)
-            if (net->freeway != (ras_socket)-1 && FD_ISSET(net->freeway, &fds)) {
-                unsigned char buf[1024];
-                char addr[64];
-                unsigned short port = 0;
-                ssize_t n = ras_net_recvfrom(net->freeway, buf, sizeof(buf), addr, sizeof(addr), &port);
-                if (n > 0) {
-                    ras_log(RAS_LOG_PROTOCOL, "Freeway %zd bytes from %s:%u", n, addr, port);
-                    // Could process client announcements here
-                }
-            }
-        }
+#ifdef __linux__
+        if (n > 1) n = start_workers(workers, n, net);
+#endif
+        ras_log(RAS_LOG_INFO, "Server running, %zu shares, %zu printers, %d worker%s (%s)",
+                cfg->share_count, cfg->printer_count, n, n == 1 ? "" : "s", ras_event_backend());
 
-        time_t now = time(NULL);
-        if (cfg->server.broadcast_interval > 0 && (now - last_bcast) >= cfg->server.broadcast_interval) {
-            ras_broadcast_shares(cfg, net);
-            ras_broadcast_printers(cfg, net);
-            broadcast_dead_handles(handles, net);
-            last_bcast = now;
-        }
+        rc = ras_event_run(&workers[0].loop);
 
-        ras_printers_poll(cfg);
+#ifdef __linux__
+        for (int i = 1; i < n; ++i) {
+            if (!workers[i].started) continue;
+            ras_event_stop(&workers[i].loop);
+            ras_thread_join(workers[i].thread);
+        }
+#endif
     }
 
-    return 0; // unreachable for now
+    for (int i = 0; i < n; ++i) {
+        worker_cleanup(&workers[i]);
+    }
+    free(workers);
+    ras_attrcache_shutdown();
+    ras_pathcache_shutdown();
+    ras_dircache_shutdown();
+    ras_statpool_shutdown();
+    ras_hostfs_shutdown();
+    return rc;
 }
@@ -0,0 +1,167 @@
+// RISC OS Access/ShareFS Server - Parallel Stat Pool
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "statpool.h"
+#include "hostfs.h"
+#include "log.h"
+#include "platform.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+int ras_statpool_init(const ras_config *cfg) {
+    (void)cfg;
+    return 0;
+}
+
+void ras_statpool_shutdown(void) {
+}
+
+#else
+// Entries claimed by a thread at a time
+#define STATPOOL_CHUNK 16
+
+// Directories smaller than this are not worth waking other threads for
+#define STATPOOL_MIN_ENTRIES 64
+
+// One directory's names, shared between its caller and pool threads.
+// Lives on the caller's stack until every claimed entry is done.
+typedef struct stat_job {
+    struct stat_job *next;     // Queue of jobs with unclaimed entries
+    int dir_fd;
+    const char *const *names;
+    struct stat *st;
+    int *ok;
+    size_t count;
+    size_t claimed;            // Entries handed out so far
+    size_t done;               // Entries finished
+    int helpers;               // Pool threads that may still join
+} stat_job;
+
+// Set up by ras_statpool_init only when the pool has threads
+static ras_mutex g_lock;
+static ras_cond g_work;  // Job queued, or stopping
+static ras_cond g_done;  // A job finished
+static stat_job *g_queue = NULL;
+static ras_thread *g_threads = NULL;
+static int g_thread_count = 0;
+static int g_stop = 0;
+
+static void unlink_job(stat_job *job) {
+    for (stat_job **pp = &g_queue; *pp; pp = &(*pp)->next) {
+        if (*pp == job) {
+            *pp = job->next;
+            return;
+        }
+    }
+}
+
+// Claim and stat chunks of a job until all are handed out.
+// Called and returns with g_lock held; the stats run unlocked.
+static void run_job(stat_job *job) {
+    while (job->claimed < job->count) {
+        size_t first = job->claimed;
+        size_t n = job->count - first < STATPOOL_CHUNK ? job->count - first : STATPOOL_CHUNK;
+        job->claimed += n;
+        if (job->claimed == job->count) unlink_job(job);
+
+        ras_mutex_unlock(&g_lock);
+        for (size_t i = first; i < first + n; ++i) {
+            job->ok[i] = ras_hostfs_statat(job->dir_fd, job->names[i], &job->st[i]) == 0;
+        }
+        ras_mutex_lock(&g_lock);
+
+        job->done += n;
+        if (job->done == job->count) ras_cond_broadcast(&g_done);
+    }
+}
+
+static void *pool_main(void *arg) {
+    (void)arg;
+    ras_mutex_lock(&g_lock);
+    for (;;) {
+        stat_job *job = g_queue;
+        while (job && job->helpers == 0) job = job->next;
+        if (job) {
+            job->helpers--;
+            run_job(job);
+            continue;
+        }
+        if (g_stop) break;
+        ras_cond_wait(&g_work, &g_lock);
+    }
+    ras_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+int ras_statpool_init(const ras_config *cfg) {
+    int want = 0;
+    for (size_t i = 0; cfg && i < cfg->share_count; ++i) {
+        if (cfg->shares[i].stat_threads - 1 > want) want = cfg->shares[i].stat_threads - 1;
+    }
+    if (want == 0) return 0;
+
+    g_threads = (ras_thread *)calloc((size_t)want, sizeof(ras_thread));
+    if (!g_threads) return -1;
+    ras_mutex_init(&g_lock);
+    ras_cond_init(&g_work);
+    ras_cond_init(&g_done);
+    g_stop = 0;
+    for (int i = 0; i < want; ++i) {
+        if (ras_thread_create(&g_threads[g_thread_count], pool_main, NULL) != 0) {
+            ras_log(RAS_LOG_ERROR, "stat pool: started %d of %d threads", g_thread_count, want);
+            break;
+        }
+        g_thread_count++;
+    }
+    return 0;
+}
+
+void ras_statpool_shutdown(void) {
+    if (!g_threads) return;
+    ras_mutex_lock(&g_lock);
+    g_stop = 1;
+    ras_cond_broadcast(&g_work);
+    ras_mutex_unlock(&g_lock);
+    for (int i = 0; i < g_thread_count; ++i) ras_thread_join(g_threads[i]);
+    ras_cond_destroy(&g_done);
+    ras_cond_destroy(&g_work);
+    ras_mutex_destroy(&g_lock);
+    free(g_threads);
+    g_threads = NULL;
+    g_thread_count = 0;
+}
+
+void ras_statpool_stat(int dir_fd, const char *const *names, size_t count,
+                       struct stat *st, int *ok, int concurrency) {
+    if (concurrency <= 1 || g_thread_count == 0 || count < STATPOOL_MIN_ENTRIES) {
+        for (size_t i = 0; i < count; ++i) ok[i] = ras_hostfs_statat(dir_fd, names[i], &st[i]) == 0;
+        return;
+    }
+
+    stat_job job;
+    job.next = NULL;
+    job.dir_fd = dir_fd;
+    job.names = names;
+    job.st = st;
+    job.ok = ok;
+    job.count = count;
+    job.claimed = 0;
+    job.done = 0;
+    job.helpers = concurrency - 1 < g_thread_count ? concurrency - 1 : g_thread_count;
+
+    ras_mutex_lock(&g_lock);
+    stat_job **tail = &g_queue;
+    while (*tail) tail = &(*tail)->next;
+    *tail = &job;
+    ras_cond_broadcast(&g_work);
+
+    // The caller works through the names too, then waits for stragglers
+    run_job(&job);
+    while (job.done < job.count) ras_cond_wait(&g_done, &g_lock);
+    ras_mutex_unlock(&g_lock);
+}
+
+#endif
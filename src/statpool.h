@@ -0,0 +1,26 @@
+// RISC OS Access/ShareFS Server - Parallel Stat Pool
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_STATPOOL_H
+#define RAS_STATPOOL_H
+
+#include "config.h"
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+// Start enough threads for the share with the highest stat_threads.
+// Windows listings stat by path without the pool, so it starts none.
+int ras_statpool_init(const ras_config *cfg);
+void ras_statpool_shutdown(void);
+
+#ifndef _WIN32
+// ras_hostfs_statat() every name in the directory dir_fd, using up to concurrency
+// threads including the caller. ok[i] is 1 where st[i] was filled in.
+// Small directories, or a concurrency of 1, are done by the caller alone.
+void ras_statpool_stat(int dir_fd, const char *const *names, size_t count,
+                       struct stat *st, int *ok, int concurrency);
+#endif
+
+#endif
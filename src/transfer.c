@@ -0,0 +1,346 @@
+// RISC OS Access/ShareFS Server - Transfer Registry
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "transfer.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKETS 64
+
+// FNV-1a over the transfer key
+static size_t hash_key(ras_transfer_kind kind, const unsigned char *rid, const char *addr, unsigned short port) {
+    uint32_t h = 2166136261u;
+    for (const char *p = addr; *p; ++p) {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    unsigned char tail[6] = { rid[0], rid[1], rid[2],
+                              (unsigned char)(port & 0xFF), (unsigned char)(port >> 8),
+                              (unsigned char)kind };
+    for (size_t i = 0; i < sizeof(tail); ++i) {
+        h ^= tail[i];
+        h *= 16777619u;
+    }
+    return (size_t)h;
+}
+
+static int key_matches(const ras_transfer *x, ras_transfer_kind kind, const unsigned char *rid,
+                       const char *addr, unsigned short port) {
+    return x->kind == kind && x->port == port &&
+           x->rid[0] == rid[0] && x->rid[1] == rid[1] && x->rid[2] == rid[2] &&
+           strcmp(x->addr, addr) == 0;
+}
+
+static void wheel_unlink(ras_transfer_table *t, ras_transfer *x) {
+    if (!x->scheduled) return;
+    if (x->wheel_prev) {
+        x->wheel_prev->wheel_next = x->wheel_next;
+    } else {
+        t->wheel[(x->due_ms / RAS_TRANSFER_TICK_MS) % RAS_TRANSFER_WHEEL_SLOTS] = x->wheel_next;
+    }
+    if (x->wheel_next) x->wheel_next->wheel_prev = x->wheel_prev;
+    x->wheel_next = NULL;
+    x->wheel_prev = NULL;
+    x->scheduled = 0;
+}
+
+static void wheel_link(ras_transfer_table *t, ras_transfer *x, uint64_t due_ms) {
+    wheel_unlink(t, x);
+    // Never schedule into a tick the wheel has already passed
+    uint64_t min_due = (t->wheel_tick + 1) * RAS_TRANSFER_TICK_MS;
+    if (due_ms < min_due) due_ms = min_due;
+    x->due_ms = due_ms;
+    ras_transfer **slot = &t->wheel[(due_ms / RAS_TRANSFER_TICK_MS) % RAS_TRANSFER_WHEEL_SLOTS];
+    x->wheel_prev = NULL;
+    x->wheel_next = *slot;
+    if (*slot) (*slot)->wheel_prev = x;
+    *slot = x;
+    x->scheduled = 1;
+}
+
+static void drop_segs(ras_transfer *x) {
+    for (size_t i = 0; i < x->seg_count; ++i) free(x->segs[i].data);
+    free(x->segs);
+    x->segs = NULL;
+    x->seg_count = 0;
+    x->seg_cap = 0;
+    x->stashed = 0;
+}
+
+static ras_transfer **bucket_for(ras_transfer_table *t, const ras_transfer *x) {
+    return &t->buckets[hash_key(x->kind, x->rid, x->addr, x->port) & (t->bucket_count - 1)];
+}
+
+// Keep the load factor at or below one so chains stay short
+static void grow_buckets(ras_transfer_table *t) {
+    size_t n = t->bucket_count * 2;
+    ras_transfer **old = t->buckets;
+    size_t old_count = t->bucket_count;
+    ras_transfer **p = (ras_transfer **)calloc(n, sizeof(ras_transfer *));
+    if (!p) return;  // Longer chains, still correct
+
+    t->buckets = p;
+    t->bucket_count = n;
+    for (size_t i = 0; i < old_count; ++i) {
+        ras_transfer *x = old[i];
+        while (x) {
+            ras_transfer *next = x->next;
+            ras_transfer **b = bucket_for(t, x);
+            x->next = *b;
+            *b = x;
+            x = next;
+        }
+    }
+    free(old);
+}
+
+int ras_transfers_init(ras_transfer_table *t, size_t max, uint64_t idle_ms, size_t reorder_max) {
+    if (!t) return -1;
+    memset(t, 0, sizeof(*t));
+    t->buckets = (ras_transfer **)calloc(INITIAL_BUCKETS, sizeof(ras_transfer *));
+    if (!t->buckets) return -1;
+    t->bucket_count = INITIAL_BUCKETS;
+    t->max = max > 0 ? max : 1;
+    t->idle_ms = idle_ms;
+    t->reorder_max = reorder_max;
+    t->wheel_tick = ras_monotonic_ms() / RAS_TRANSFER_TICK_MS;
+    return 0;
+}
+
+void ras_transfers_free(ras_transfer_table *t) {
+    if (!t) return;
+    for (size_t i = 0; i < t->bucket_count; ++i) {
+        ras_transfer *x = t->buckets[i];
+        while (x) {
+            ras_transfer *next = x->next;
+            drop_segs(x);
+            free(x);
+            x = next;
+        }
+    }
+    while (t->spare) {
+        ras_transfer *next = t->spare->next;
+        free(t->spare);
+        t->spare = next;
+    }
+    free(t->buckets);
+    memset(t, 0, sizeof(*t));
+}
+
+ras_transfer *ras_transfers_find(ras_transfer_table *t, ras_transfer_kind kind,
+                                 const unsigned char *rid, const char *addr, unsigned short port) {
+    if (!t || !t->buckets || !rid || !addr) return NULL;
+    ras_transfer *x = t->buckets[hash_key(kind, rid, addr, port) & (t->bucket_count - 1)];
+    while (x && !key_matches(x, kind, rid, addr, port)) x = x->next;
+    return x;
+}
+
+static void set_key(ras_transfer *x, ras_transfer_kind kind, const unsigned char *rid,
+                    const char *addr, unsigned short port) {
+    x->kind = kind;
+    x->rid[0] = rid[0];
+    x->rid[1] = rid[1];
+    x->rid[2] = rid[2];
+    strncpy(x->addr, addr, sizeof(x->addr) - 1);
+    x->addr[sizeof(x->addr) - 1] = '\0';
+    x->port = port;
+}
+
+// Fresh transfers start from the worker's current RTT estimate
+static void reset_timing(ras_transfer_table *t, ras_transfer *x) {
+    x->srtt_ms = t->srtt_ms;
+    x->rttvar_ms = t->rttvar_ms;
+    if (x->srtt_ms > 0) {
+        uint32_t rto = x->srtt_ms + 4 * x->rttvar_ms;
+        if (rto < RAS_TRANSFER_RTO_MIN_MS) rto = RAS_TRANSFER_RTO_MIN_MS;
+        if (rto > RAS_TRANSFER_RTO_MAX_MS) rto = RAS_TRANSFER_RTO_MAX_MS;
+        x->rto_ms = rto;
+    } else {
+        x->rto_ms = RAS_TRANSFER_RTO_INIT_MS;
+    }
+    x->active_ms = ras_monotonic_ms();
+}
+
+ras_transfer *ras_transfers_add(ras_transfer_table *t, ras_transfer_kind kind,
+                                const unsigned char *rid, const char *addr, unsigned short port) {
+    if (!t || !t->buckets || !rid || !addr) return NULL;
+
+    // Client retried the request: restart in place
+    ras_transfer *x = ras_transfers_find(t, kind, rid, addr, port);
+    if (x) {
+        wheel_unlink(t, x);
+        drop_segs(x);
+        ras_transfer *next = x->next;
+        memset(x, 0, sizeof(*x));
+        x->next = next;
+        set_key(x, kind, rid, addr, port);
+        reset_timing(t, x);
+        return x;
+    }
+
+    if (t->count >= t->max) return NULL;
+    if (t->spare) {
+        x = t->spare;
+        t->spare = x->next;
+        memset(x, 0, sizeof(*x));
+    } else {
+        x = (ras_transfer *)calloc(1, sizeof(ras_transfer));
+        if (!x) return NULL;
+    }
+    if (t->count >= t->bucket_count) grow_buckets(t);
+
+    set_key(x, kind, rid, addr, port);
+    reset_timing(t, x);
+    ras_transfer **b = bucket_for(t, x);
+    x->next = *b;
+    *b = x;
+    t->count++;
+    return x;
+}
+
+void ras_transfers_remove(ras_transfer_table *t, ras_transfer *x) {
+    if (!t || !x || !t->buckets) return;
+    ras_transfer **pp = bucket_for(t, x);
+    while (*pp && *pp != x) pp = &(*pp)->next;
+    if (!*pp) return;
+    wheel_unlink(t, x);
+    drop_segs(x);
+    *pp = x->next;
+    t->count--;
+    x->next = t->spare;
+    t->spare = x;
+}
+
+void ras_transfers_sent(ras_transfer_table *t, ras_transfer *x) {
+    if (!t || !x) return;
+    x->sent_ms = ras_monotonic_ms();
+    ras_transfers_waiting(t, x);
+}
+
+void ras_transfers_waiting(ras_transfer_table *t, ras_transfer *x) {
+    if (!t || !x) return;
+    uint64_t now = ras_monotonic_ms();
+    uint64_t due = now + x->rto_ms;
+    // Wake for the idle limit if that comes first
+    if (t->idle_ms > 0 && x->active_ms + t->idle_ms < due) due = x->active_ms + t->idle_ms;
+    wheel_link(t, x, due);
+}
+
+void ras_transfers_acked(ras_transfer_table *t, ras_transfer *x) {
+    if (!t || !x) return;
+    uint64_t now = ras_monotonic_ms();
+    x->active_ms = now;
+
+    // Karn's rule: an answer to a retransmitted packet is ambiguous
+    // Only the first answer to a packet measures the round trip
+    if (x->retries == 0 && x->sent_ms > 0 && now >= x->sent_ms) {
+        uint64_t sample64 = now - x->sent_ms;
+        uint32_t rtt = sample64 > RAS_TRANSFER_RTO_MAX_MS ? RAS_TRANSFER_RTO_MAX_MS : (uint32_t)sample64;
+        if (x->srtt_ms == 0) {
+            x->srtt_ms = rtt > 0 ? rtt : 1;
+            x->rttvar_ms = rtt / 2;
+        } else {
+            uint32_t err = rtt > x->srtt_ms ? rtt - x->srtt_ms : x->srtt_ms - rtt;
+            x->rttvar_ms = (3 * x->rttvar_ms + err) / 4;
+            x->srtt_ms = (7 * x->srtt_ms + rtt) / 8;
+            if (x->srtt_ms == 0) x->srtt_ms = 1;
+        }
+        t->srtt_ms = x->srtt_ms;
+        t->rttvar_ms = x->rttvar_ms;
+    }
+    x->sent_ms = 0;
+
+    x->retries = 0;
+    uint32_t rto = x->srtt_ms > 0 ? x->srtt_ms + 4 * x->rttvar_ms : RAS_TRANSFER_RTO_INIT_MS;
+    if (rto < RAS_TRANSFER_RTO_MIN_MS) rto = RAS_TRANSFER_RTO_MIN_MS;
+    if (rto > RAS_TRANSFER_RTO_MAX_MS) rto = RAS_TRANSFER_RTO_MAX_MS;
+    x->rto_ms = rto;
+}
+
+void ras_transfers_backoff(ras_transfer *x) {
+    if (!x) return;
+    x->retries++;
+    x->rto_ms = x->rto_ms * 2 > RAS_TRANSFER_RTO_MAX_MS ? RAS_TRANSFER_RTO_MAX_MS : x->rto_ms * 2;
+}
+
+void ras_transfers_expire(ras_transfer_table *t, uint64_t now, ras_transfer_expire_fn fn, void *ctx) {
+    if (!t || !fn) return;
+    // Only ticks that have fully elapsed are processed, so nothing can be
+    // left behind in a slot the wheel has already moved past
+    uint64_t now_tick = now / RAS_TRANSFER_TICK_MS;
+
+    // After a long stall one lap visits every slot
+    if (now_tick > t->wheel_tick + 1 + RAS_TRANSFER_WHEEL_SLOTS) {
+        t->wheel_tick = now_tick - 1 - RAS_TRANSFER_WHEEL_SLOTS;
+    }
+
+    while (t->wheel_tick + 1 < now_tick) {
+        t->wheel_tick++;
+        ras_transfer **slot = &t->wheel[t->wheel_tick % RAS_TRANSFER_WHEEL_SLOTS];
+
+        // Detach the slot so callbacks can reschedule into it safely
+        ras_transfer *x = *slot;
+        *slot = NULL;
+        while (x) {
+            ras_transfer *next = x->wheel_next;
+            x->wheel_next = NULL;
+            x->wheel_prev = NULL;
+            x->scheduled = 0;
+            if (x->due_ms <= now) {
+                fn(x, now, ctx);
+            } else {
+                // Due on a later lap: put it back
+                x->wheel_next = *slot;
+                if (*slot) (*slot)->wheel_prev = x;
+                *slot = x;
+                x->scheduled = 1;
+            }
+            x = next;
+        }
+    }
+}
+
+int ras_transfers_stash(ras_transfer_table *t, ras_transfer *x, uint32_t pos, const void *data, size_t len) {
+    if (!t || !x || !data || len == 0) return -1;
+    if (x->stashed + len > t->reorder_max) return -1;
+
+    // Find the insertion point; a packet we already hold is a duplicate
+    size_t i = 0;
+    while (i < x->seg_count && x->segs[i].pos < pos) i++;
+    if (i < x->seg_count && x->segs[i].pos == pos && x->segs[i].len >= len) return 0;
+
+    if (x->seg_count == x->seg_cap) {
+        size_t n = x->seg_cap ? x->seg_cap * 2 : 8;
+        ras_transfer_seg *p = (ras_transfer_seg *)realloc(x->segs, n * sizeof(ras_transfer_seg));
+        if (!p) return -1;
+        x->segs = p;
+        x->seg_cap = n;
+    }
+    unsigned char *copy = (unsigned char *)malloc(len);
+    if (!copy) return -1;
+    memcpy(copy, data, len);
+
+    memmove(&x->segs[i + 1], &x->segs[i], (x->seg_count - i) * sizeof(ras_transfer_seg));
+    x->segs[i].pos = pos;
+    x->segs[i].len = (uint32_t)len;
+    x->segs[i].data = copy;
+    x->seg_count++;
+    x->stashed += len;
+    return 0;
+}
+
+const ras_transfer_seg *ras_transfers_ready_seg(const ras_transfer *x) {
+    if (!x || x->seg_count == 0 || x->segs[0].pos > x->current_pos) return NULL;
+    return &x->segs[0];
+}
+
+void ras_transfers_pop_seg(ras_transfer *x) {
+    if (!x || x->seg_count == 0) return;
+    x->stashed -= x->segs[0].len;
+    free(x->segs[0].data);
+    x->seg_count--;
+    memmove(&x->segs[0], &x->segs[1], x->seg_count * sizeof(ras_transfer_seg));
+}
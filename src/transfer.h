@@ -0,0 +1,125 @@
+// RISC OS Access/ShareFS Server - Transfer Registry
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_TRANSFER_H
+#define RAS_TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Retransmission timer wheel: 256 slots of 50 ms cover 12.8 s per
+// revolution; longer deadlines simply stay in their slot for more laps
+#define RAS_TRANSFER_WHEEL_SLOTS 256
+#define RAS_TRANSFER_TICK_MS     50
+
+// Retransmit timeout bounds (RFC 6298 style estimator, Karn's rule)
+#define RAS_TRANSFER_RTO_INIT_MS 500
+#define RAS_TRANSFER_RTO_MIN_MS  200
+#define RAS_TRANSFER_RTO_MAX_MS  5000
+
+typedef enum {
+    RAS_TRANSFER_READ,        // RREAD: we send D packets, client acks with r
+    RAS_TRANSFER_WRITE        // RWRITE: we send w requests, client sends d
+} ras_transfer_kind;
+
+// Write data that arrived ahead of a hole, held until the hole is filled
+typedef struct {
+    uint32_t pos;                // Absolute file position
+    uint32_t len;
+    unsigned char *data;
+} ras_transfer_seg;
+
+// An in-flight RREAD/RWRITE, identified by the client's address, port and
+// reply ID so that two clients reusing the same rid never collide
+typedef struct ras_transfer {
+    struct ras_transfer *next;   // Hash chain
+    struct ras_transfer *wheel_next;
+    struct ras_transfer *wheel_prev;
+    int scheduled;               // Linked into the timer wheel
+    uint64_t due_ms;             // Next retransmit or idle check
+    uint64_t sent_ms;            // When the last D/w packet went out
+    uint64_t active_ms;          // Last packet from the client
+    uint32_t rto_ms;             // Current retransmit timeout
+    uint32_t srtt_ms;            // Smoothed round trip time (0 = no sample)
+    uint32_t rttvar_ms;
+    int retries;                 // Retransmits since the client last answered
+    uint32_t last_pos;           // Current window: start and length
+    uint32_t last_len;
+    uint32_t chunk;              // D/d packet payload size
+    int window;                  // Packets per window
+    int burst;                   // D packets in the current read window
+    int acked;                   // r acks received for it
+    int hole_requested;          // Missing write data already re-requested
+    int reordered;               // d packets stashed since the last progress
+    ras_transfer_seg *segs;      // Out-of-order write data, sorted by pos
+    size_t seg_count;
+    size_t seg_cap;
+    size_t stashed;              // Bytes held in segs
+    ras_transfer_kind kind;
+    int state;                   // Read protocol state
+    int handle_id;
+    uint32_t start_pos;          // Original start position from client
+    uint32_t current_pos;        // Current position in file
+    uint32_t end_pos;            // End position (start + amount)
+    unsigned char rid[3];        // Reply ID to use
+    char addr[64];               // Client address
+    unsigned short port;         // Client port
+} ras_transfer;
+
+typedef struct {
+    ras_transfer **buckets;
+    size_t bucket_count;         // Power of two
+    size_t count;
+    size_t max;                  // Budget for concurrent transfers
+    ras_transfer *spare;         // Recycled entries
+    ras_transfer *wheel[RAS_TRANSFER_WHEEL_SLOTS];
+    uint64_t wheel_tick;         // Last fully elapsed tick processed
+    uint64_t idle_ms;            // Reap transfers silent for this long
+    size_t reorder_max;          // Out-of-order write bytes held per transfer
+    uint32_t srtt_ms;            // Worker-wide estimate seeding new transfers
+    uint32_t rttvar_ms;
+} ras_transfer_table;
+
+typedef void (*ras_transfer_expire_fn)(ras_transfer *x, uint64_t now, void *ctx);
+
+int ras_transfers_init(ras_transfer_table *t, size_t max, uint64_t idle_ms, size_t reorder_max);
+void ras_transfers_free(ras_transfer_table *t);
+
+ras_transfer *ras_transfers_find(ras_transfer_table *t, ras_transfer_kind kind,
+                                 const unsigned char *rid, const char *addr, unsigned short port);
+
+// Start a transfer. A retried request with the same key restarts the
+// existing transfer. Returns NULL when the budget is exhausted.
+ras_transfer *ras_transfers_add(ras_transfer_table *t, ras_transfer_kind kind,
+                                const unsigned char *rid, const char *addr, unsigned short port);
+
+void ras_transfers_remove(ras_transfer_table *t, ras_transfer *x);
+
+// A D/w packet was (re)sent: schedule its retransmit timeout
+void ras_transfers_sent(ras_transfer_table *t, ras_transfer *x);
+
+// The client is part way through a window: push the timeout back
+// without taking a new RTT sample
+void ras_transfers_waiting(ras_transfer_table *t, ras_transfer *x);
+
+// The client answered: take an RTT sample (unless the packet was
+// retransmitted) and reset the backoff
+void ras_transfers_acked(ras_transfer_table *t, ras_transfer *x);
+
+// Double the retransmit timeout after a retransmission
+void ras_transfers_backoff(ras_transfer *x);
+
+// Hold an out-of-order d packet for absolute position pos. Returns 0 if
+// it is held (or already was), -1 if it would exceed the reorder budget.
+int ras_transfers_stash(ras_transfer_table *t, ras_transfer *x, uint32_t pos, const void *data, size_t len);
+
+// First held segment once it touches current_pos, or NULL
+const ras_transfer_seg *ras_transfers_ready_seg(const ras_transfer *x);
+void ras_transfers_pop_seg(ras_transfer *x);
+
+// Advance the wheel to now and call fn for every transfer that is due.
+// fn must either send again (ras_transfers_sent) or remove the transfer.
+void ras_transfers_expire(ras_transfer_table *t, uint64_t now, ras_transfer_expire_fn fn, void *ctx);
+
+#endif
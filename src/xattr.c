@@ -0,0 +1,71 @@
+// RISC OS Access/ShareFS Server - Extended Attribute Metadata
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#include "xattr.h"
+
+#include <errno.h>
+
+#ifdef RAS_HAVE_XATTR
+#include <sys/types.h>
+#include <sys/xattr.h>
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+int ras_xattr_get(const char *host_path, ras_xattr_info *info) {
+    if (!host_path || !info) {
+        errno = EINVAL;
+        return -1;
+    }
+    unsigned char buf[12];
+    ssize_t n = getxattr(host_path, RAS_XATTR_INFO, buf, sizeof(buf));
+    if (n != (ssize_t)sizeof(buf)) {
+        if (n >= 0) errno = EINVAL;
+        return -1;
+    }
+    info->load = get_u32(buf);
+    info->exec = get_u32(buf + 4);
+    info->attrs = get_u32(buf + 8);
+    return 0;
+}
+
+int ras_xattr_set(int fd, const char *host_path, const ras_xattr_info *info) {
+    if (!info || (fd < 0 && !host_path)) {
+        errno = EINVAL;
+        return -1;
+    }
+    unsigned char buf[12];
+    put_u32(buf, info->load);
+    put_u32(buf + 4, info->exec);
+    put_u32(buf + 8, info->attrs);
+    if (fd >= 0) return fsetxattr(fd, RAS_XATTR_INFO, buf, sizeof(buf), 0);
+    return setxattr(host_path, RAS_XATTR_INFO, buf, sizeof(buf), 0);
+}
+
+#else
+
+int ras_xattr_get(const char *host_path, ras_xattr_info *info) {
+    (void)host_path;
+    (void)info;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int ras_xattr_set(int fd, const char *host_path, const ras_xattr_info *info) {
+    (void)fd;
+    (void)host_path;
+    (void)info;
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,28 @@
+// RISC OS Access/ShareFS Server - Extended Attribute Metadata
+// Author: Andrew Timmins
+// License: GPL-3.0-only
+
+#ifndef RAS_XATTR_H
+#define RAS_XATTR_H
+
+#include <stdint.h>
+
+// Name of the extended attribute holding a file's RISC OS details on
+// shares with metadata = xattr: load, exec and attributes as three
+// little-endian words
+#define RAS_XATTR_INFO "user.riscos.info"
+
+typedef struct {
+    uint32_t load;
+    uint32_t exec;
+    uint32_t attrs;
+} ras_xattr_info;
+
+// Returns 0 if host_path carries RISC OS details, else -1 with errno set
+// (ENOTSUP where the platform or filesystem has no extended attributes)
+int ras_xattr_get(const char *host_path, ras_xattr_info *info);
+
+// Store details through fd when it is open (>= 0), else by path
+int ras_xattr_set(int fd, const char *host_path, const ras_xattr_info *info);
+
+#endif